@@ -0,0 +1,90 @@
+// imu_bin2csv.cpp
+// Converte uma gravação binária do datalogger (imu_data.bin, formato em
+// imu_log_format.h) para o CSV usado por plot_imu_data_completo.py:
+//   numero_amostra,accel_x,accel_y,accel_z,giro_x,giro_y,giro_z,tempo_us
+//
+// Compilação (no PC):
+//   g++ -std=c++17 -O2 -I.. -o imu_bin2csv imu_bin2csv.cpp
+// Uso:
+//   ./imu_bin2csv imu_data.bin [imu_data.csv]
+// Sem o segundo argumento, o CSV sai na saída padrão.
+
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+#include "imu_log_format.h"
+
+static void imprimir_cabecalho(const imu_log_header_t &h)
+{
+    static const char *modos[] = {"poll", "fifo", "irq"};
+    std::fprintf(stderr, "Taxa: %" PRIu32 " Hz, modo %s, DLPF_CFG %u, SMPLRT_DIV %u\n", h.sample_rate_hz,
+                 h.acq_mode < 3 ? modos[h.acq_mode] : "?", h.dlpf_cfg, h.smplrt_div);
+    std::fprintf(stderr, "Escalas: %.1f LSB/g, %.1f LSB/(graus/s)\n", h.accel_lsb_per_g, h.gyro_lsb_per_dps);
+    if (h.start_year)
+        std::fprintf(stderr, "Início: %02d/%02d/%04d %02d:%02d:%02d\n", h.start_day, h.start_month, h.start_year,
+                     h.start_hour, h.start_min, h.start_sec);
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        std::fprintf(stderr, "Uso: %s <arquivo.bin> [saida.csv]\n", argv[0]);
+        return 2;
+    }
+
+    std::ifstream in(argv[1], std::ios::binary);
+    if (!in)
+    {
+        std::fprintf(stderr, "Não foi possível abrir %s\n", argv[1]);
+        return 1;
+    }
+
+    imu_log_header_t h;
+    if (!in.read(reinterpret_cast<char *>(&h), sizeof(h)) || h.magic != IMU_LOG_MAGIC)
+    {
+        std::fprintf(stderr, "%s não é uma gravação do datalogger\n", argv[1]);
+        return 1;
+    }
+    if (h.version != IMU_LOG_VERSION || h.record_size != sizeof(imu_log_record_t) ||
+        h.header_size < sizeof(imu_log_header_t))
+    {
+        std::fprintf(stderr, "Versão %u do formato não suportada\n", h.version);
+        return 1;
+    }
+    imprimir_cabecalho(h);
+    in.seekg(h.header_size);
+
+    FILE *out = stdout;
+    if (argc > 2 && !(out = std::fopen(argv[2], "w")))
+    {
+        std::fprintf(stderr, "Não foi possível criar %s\n", argv[2]);
+        return 1;
+    }
+
+    std::fprintf(out, "numero_amostra,accel_x,accel_y,accel_z,giro_x,giro_y,giro_z,tempo_us\n");
+    std::vector<imu_log_record_t> bloco(4096);
+    uint64_t n = 0, t_us = 0;
+    while (in)
+    {
+        in.read(reinterpret_cast<char *>(bloco.data()), bloco.size() * sizeof(imu_log_record_t));
+        size_t lidos = in.gcount() / sizeof(imu_log_record_t);
+        for (size_t i = 0; i < lidos; i++)
+        {
+            const imu_log_record_t &r = bloco[i];
+            t_us += r.dt_us;
+            std::fprintf(out, "%" PRIu64 ",%.4f,%.4f,%.4f,%.4f,%.4f,%.4f,%" PRIu64 "\n", ++n,
+                         r.accel[0] / h.accel_lsb_per_g, r.accel[1] / h.accel_lsb_per_g,
+                         r.accel[2] / h.accel_lsb_per_g, r.gyro[0] / h.gyro_lsb_per_dps,
+                         r.gyro[1] / h.gyro_lsb_per_dps, r.gyro[2] / h.gyro_lsb_per_dps, t_us);
+        }
+    }
+    if (out != stdout)
+        std::fclose(out);
+    std::fprintf(stderr, "%" PRIu64 " amostras convertidas\n", n);
+    return 0;
+}
@@ -9,17 +9,29 @@
 #include "hardware/adc.h"
 #include "hardware/rtc.h"
 #include "pico/stdlib.h"
+#include "pico/multicore.h"
 #include "lib/FatFs_SPI/ssd1306.h"
 #include "hardware/i2c.h"
+#include "hardware/clocks.h"
+#include "hardware/structs/systick.h"
 #include "ff.h"
 #include "diskio.h"
+#include "disk_async.h"
 #include "f_util.h"
+#include "f_lines.h"
+#include "f_stream.h"
+#include "storage_bench.h"
+#include "trace.h"
 #include "hw_config.h"
 #include "my_debug.h"
 #include "rtc.h"
 #include "sd_card.h"
+#include "crc.h"
 #include <math.h>
 #include "pico/binary_info.h"
+#include "sample_ring.h"
+#include "i2c_dma.h"
+#include "imu_log_format.h"
 
 // =============================================
 // DEFINIÇÕES DE CONSTANTES E PINOS
@@ -28,6 +40,7 @@
 #define I2C_PORT i2c0            // Porta I2C principal
 #define I2C_SDA 0                // Pino SDA I2C
 #define I2C_SCL 1                // Pino SCL I2C
+#define MPU6050_INT_PIN 8        // Pino INT do MPU6050 (data-ready no modo 'irq')
 #define I2C_DISPLAY i2c1         // Porta I2C para display
 #define PIN_I2C_SDA_DISPLAY 14   // Pino SDA para display
 #define PIN_I2C_SCL_DISPLAY 15   // Pino SCL para display
@@ -40,6 +53,67 @@
 #define REST 0                   // Define repouso para o buzzer
 #define WIDTH 128                // Largura do display OLED
 #define HEIGHT 64                // Altura do display OLED
+#define SAMPLE_RATE_HZ 100       // Taxa de amostragem padrão do MPU6050 (Hz)
+#define SAMPLE_RATE_MIN_HZ 100   // Taxa mínima aceita pelo comando 'rate'
+#define SAMPLE_RATE_MAX_HZ 1000  // Taxa máxima aceita pelo comando 'rate'
+#define SAMPLE_RING_CAPACITY 4096 // Amostras no anel entre o timer e o SD (potência de 2)
+#define MULTICORE_MODE 1         // 1: MPU6050 no núcleo 1; SD, display e shell no núcleo 0
+#define CORE1_CMD_START 0x10000000u // Comando ao núcleo 1: inicia amostragem (taxa nos bits baixos)
+#define CORE1_CMD_STOP 0x20000000u  // Comando ao núcleo 1: para a amostragem
+#define CORE1_CMD_BENCH 0x30000000u // Comando ao núcleo 1: mede a leitura do sensor (iterações nos bits baixos)
+#define CORE1_CMD_MASK 0xF0000000u
+#define UI_REFRESH_MS 500        // Período de atualização do display durante a gravação
+#define MPU6050_BURST_READ 1     // 1: lê 0x3B..0x48 numa só rajada I2C por DMA; 0: três leituras bloqueantes
+#define MPU6050_DATA_LEN 14      // Bytes de 0x3B (ACCEL_XOUT_H) a 0x48 (GYRO_ZOUT_L)
+#define SAMPLER_DRAIN_TIMEOUT_US 100000 // Espera máxima pela leitura em andamento ao parar
+#define LOG_STAGING_SIZE (16 * 1024) // Buffer de gravação: 4 a 32 KiB, múltiplo de 512
+#define LOG_CLMT_SIZE 8          // Tabela de fast seek: 4 itens bastam para um arquivo contíguo
+#define PREALLOC_MAX_S 86400     // Maior duração aceita pelo comando 'prealloc'
+#define IMU_BENCH_DEFAULT_ITER 200 // Iterações padrão do comando 'imubench'
+#define SPI_BENCH_DEFAULT_ITER 500 // Iterações padrão do comando 'spibench'
+#define WRITE_BENCH_DEFAULT_N 256  // Setores escritos por política no comando 'wbench'
+#define CRC_BENCH_DEFAULT_N 2000   // Blocos de 512 bytes por método no comando 'crcbench'
+#define BENCH_SEQ_DEFAULT_KIB 4096 // Tamanho padrão do arquivo sequencial do comando 'bench'
+#define BENCH_CSV "bench.csv"      // Resultados do 'bench', acumulados entre execuções
+#define LINE_READ_SIZE 4096        // Buffer do leitor de linhas do 'linebench': 8 setores por f_read
+#define STREAM_BUF_SIZE (16 * 1024) // Leitura em fluxo ('cat', read_file): duas metades de 8 KiB
+#define STREAM_USB_PIECE 256       // Bytes por fwrite para a USB entre duas chamadas a disk_async_poll()
+#define CSV_OUT_SIZE 1024          // Linhas de CSV acumuladas até este tamanho antes do fwrite
+#define FIFO_FRAME_SIZE 12       // Bytes por amostra na FIFO: acelerômetro (6) + giroscópio (6)
+#define FIFO_SIZE 1024           // Capacidade da FIFO interna do MPU6050
+
+// Registradores do MPU6050
+#define MPU6050_SMPLRT_DIV 0x19   // Taxa = 1 kHz / (1 + SMPLRT_DIV) com o DLPF ligado
+#define MPU6050_CONFIG 0x1A       // DLPF_CFG nos bits 2:0
+#define MPU6050_GYRO_CONFIG 0x1B  // FS_SEL nos bits 4:3
+#define MPU6050_ACCEL_CONFIG 0x1C // AFS_SEL nos bits 4:3
+#define MPU6050_FIFO_EN 0x23
+#define MPU6050_INT_PIN_CFG 0x37
+#define MPU6050_INT_ENABLE 0x38
+#define MPU6050_INT_STATUS 0x3A
+#define MPU6050_USER_CTRL 0x6A
+#define MPU6050_PWR_MGMT_1 0x6B
+#define MPU6050_FIFO_COUNTH 0x72
+#define MPU6050_FIFO_R_W 0x74
+
+#define MPU6050_DLPF_CFG 1             // Banda de ~188 Hz e giroscópio interno a 1 kHz
+#define MPU6050_GYRO_FS_SEL 0          // ±250 °/s
+#define MPU6050_ACCEL_FS_SEL 0         // ±2 g
+#define MPU6050_ACCEL_LSB_PER_G 16384.0f
+#define MPU6050_GYRO_LSB_PER_DPS 131.0f
+#define MPU6050_FIFO_EN_ACCEL_GYRO 0x78 // XG, YG, ZG e ACCEL na FIFO
+#define MPU6050_USER_CTRL_FIFO_EN 0x40
+#define MPU6050_USER_CTRL_FIFO_RESET 0x04
+#define MPU6050_INT_FIFO_OFLOW 0x10
+#define MPU6050_INT_DATA_RDY 0x01
+#define MPU6050_INT_RD_CLEAR 0x10      // INT_PIN_CFG: qualquer leitura limpa o status
+
+// Modos de aquisição do sensor
+typedef enum {
+    IMU_MODE_POLL,  // Timer lê os registradores de dados a cada amostra
+    IMU_MODE_FIFO,  // Sensor amostra sozinho; o timer drena a FIFO em rajadas
+    IMU_MODE_IRQ    // Sensor amostra sozinho; o pino INT dispara cada leitura
+} imu_mode_t;
 
 // =============================================
 // VARIÁVEIS GLOBAIS
@@ -52,8 +126,28 @@ bool recording = false;                     // Flag para gravação em andamento
 ssd1306_t ssd;                              // Objeto do display OLED
 static const uint32_t period = 1000;        // Período para operações periódicas
 static absolute_time_t next_log_time;       // Tempo para próximo log
-static char filename[20] = "imu_data.csv";  // Nome do arquivo de dados
+static char filename[20] = "imu_data.bin";  // Nome do arquivo de dados (formato em imu_log_format.h)
 static int addr = 0x68;                     // Endereço I2C do MPU6050
+static uint32_t sample_rate_hz = SAMPLE_RATE_HZ; // Taxa de amostragem configurada
+static uint32_t prealloc_seconds = 0;       // Duração reservada no cartão ao iniciar (0 = desligado)
+static repeating_timer_t sample_timer;      // Timer de hardware que dispara as leituras
+static alarm_pool_t *sampler_pool;          // Pool de alarmes do núcleo dono do MPU6050
+static imu_mode_t imu_mode = IMU_MODE_POLL; // Modo de aquisição (comando 'mode')
+static uint32_t fifo_period_us;             // Intervalo entre amostras no modo FIFO
+static volatile uint32_t fifo_overflows = 0; // Estouros da FIFO do MPU6050
+static i2c_dma_t mpu_dma;                   // Leituras assíncronas do I2C0 por DMA
+static sample_ring_t sample_ring;           // Anel SPSC entre o amostrador e o gravador
+static imu_sample_t sample_buf[SAMPLE_RING_CAPACITY]; // Armazenamento do anel
+
+// Totais do gravador para o comando 'stats'. O anel zera os próprios
+// contadores a cada gravação, então eles são somados aqui antes de cada reset;
+// os *_base descontam o que já estava no anel no último 'stats'.
+static struct {
+    uint32_t samples, drops, high_watermark;
+    uint32_t samples_base, drops_base;
+    uint32_t write_errors; // f_write, f_lseek, f_truncate, f_close e blocos da fila que falharam
+} logger_stats;
+static sd_card_stats_t capture_sd_stats; // Contadores do SD no início da gravação
 
 // =============================================
 // PROTÓTIPOS DE FUNÇÕES
@@ -67,16 +161,32 @@ void buzzer_init();
 void led_init(int led);
 void button_init(int button);
 void display_init();
+static void ui_pause_ms(uint32_t ms);
 
 // Funções do MPU6050
 static void mpu6050_reset();
 static void mpu6050_read_raw(int16_t accel[3], int16_t gyro[3], int16_t *temp);
+static void mpu6050_read_burst(int16_t accel[3], int16_t gyro[3], int16_t *temp);
+static uint32_t mpu6050_configure(uint32_t rate_hz, imu_mode_t mode);
+
+// Funções do amostrador
+static void mpu6050_bus_init();
+static void mpu6050_int_irq_handler();
+static bool sampler_start(uint32_t rate_hz);
+static void sampler_stop();
+static bool sampler_request_start(uint32_t rate_hz);
+static void sampler_request_stop();
+static void core1_entry();
+static bool imu_bench(uint32_t iterations);
 
 // Funções do sistema de arquivos
 bool is_sd_mounted();
 static sd_card_t *sd_get_by_name(const char *const name);
 static FATFS *sd_get_fs_by_name(const char *name);
+void capture_start();
 void capture_mpu6050_data_and_save();
+static void capture_keep_alive();
+void capture_stop();
 void read_file(const char *filename);
 
 // Funções de comandos
@@ -87,6 +197,19 @@ static void run_unmount();
 static void run_getfree();
 static void run_ls();
 static void run_cat();
+static void run_rate();
+static void run_imubench();
+static void run_spibench();
+static void run_sdcheck();
+static void run_wbench();
+static void run_bench();
+static void run_trace();
+static void run_stats();
+static void run_sdclock();
+static void run_crcbench();
+static void run_linebench();
+static void run_mode();
+static void run_prealloc();
 static void run_help();
 
 // Funções auxiliares
@@ -109,6 +232,19 @@ static cmd_def_t cmds[] = {
     {"getfree", run_getfree, "getfree [<drive#:>]: Espaço livre"},
     {"ls", run_ls, "ls: Lista arquivos"},
     {"cat", run_cat, "cat <filename>: Mostra conteúdo do arquivo"},
+    {"rate", run_rate, "rate [<Hz>]: Mostra ou define a taxa de amostragem (100 a 1000 Hz)"},
+    {"mode", run_mode, "mode [poll|fifo|irq]: Mostra ou define o modo de aquisição do MPU6050"},
+    {"prealloc", run_prealloc, "prealloc [<s>]: Reserva no SD espaço contíguo para <s> segundos de gravação (0 desliga)"},
+    {"imubench", run_imubench, "imubench [<n>]: Compara o tempo de leitura do MPU6050 (3 leituras x rajada)"},
+    {"spibench", run_spibench, "spibench [<n>]: Comandos por segundo (CMD13 e CMD17) com e sem o caminho curto do SPI"},
+    {"sdcheck", run_sdcheck, "sdcheck [every|<n>|sync]: Mostra ou define quando o CMD13 confere o status após as escritas"},
+    {"sdclock", run_sdclock, "sdclock: Frequência do SPI negociada com o cartão SD"},
+    {"crcbench", run_crcbench, "crcbench [<n>]: Confere e mede o CRC16 dos blocos do SD (tabela, slice-by-N)"},
+    {"linebench", run_linebench, "linebench <arquivo>: Linhas por segundo com f_gets e com o leitor em blocos"},
+    {"wbench", run_wbench, "wbench [<n>]: Latência de escrita de um setor com cada política do CMD13"},
+    {"bench", run_bench, "bench [<KiB>]: Vazão sequencial, latência de setores ao acaso e de escritas pequenas, f_sync e montagem (CSV em " BENCH_CSV ")"},
+    {"trace", run_trace, "trace [dump|clear|on|off]: Eventos de tempo dos caminhos quentes (compilar com USE_TRACE)"},
+    {"stats", run_stats, "stats: Mostra e zera os contadores do gravador, FatFs, SD e SPI"},
     {"help", run_help, "help: Mostra comandos disponíveis"}
 };
 
@@ -135,12 +271,16 @@ int main() {
     gpio_set_irq_enabled_with_callback(buttonA, GPIO_IRQ_EDGE_FALL, true, &debounce);
     gpio_set_irq_enabled(buttonB, GPIO_IRQ_EDGE_FALL, true);
 
-    // Inicialização do I2C para comunicação com MPU6050
-    i2c_init(I2C_PORT, 400 * 1000);
-    gpio_set_function(I2C_SDA, GPIO_FUNC_I2C);
-    gpio_set_function(I2C_SCL, GPIO_FUNC_I2C);
-    gpio_pull_up(I2C_SDA);
-    gpio_pull_up(I2C_SCL);
+    // Anel entre o timer de amostragem e a gravação no SD
+    sample_ring_init(&sample_ring, sample_buf, SAMPLE_RING_CAPACITY);
+
+#if MULTICORE_MODE
+    // O núcleo 1 inicializa e passa a ser o único dono do I2C0/MPU6050
+    multicore_launch_core1(core1_entry);
+#else
+    mpu6050_bus_init();
+    sampler_pool = alarm_pool_get_default();
+#endif
 
     // Configuração inicial do sistema
     set_led_color("init");
@@ -165,10 +305,19 @@ int main() {
         if (PICO_ERROR_TIMEOUT != cRxedChar)
             process_stdio(cRxedChar);
 
+        // Gravação em andamento: o núcleo 0 apenas drena o anel entre os comandos
+        if (recording) {
+            capture_mpu6050_data_and_save();
+            if (!logger_enabled)
+                capture_stop();
+        }
+
         if (toggle_sd_requested) {
             toggle_sd_requested = false;
-            set_led_color("init");
-            if (is_sd_mounted()) {
+            if (recording) {
+                printf("\nPare a gravação antes de desmontar o SD.\n");
+            } else if (is_sd_mounted()) {
+                set_led_color("init");
                 ssd1306_fill(&ssd, !borda);
                 ssd1306_rect(&ssd, 3, 3, 122, 60, borda, !borda);
                 ssd1306_draw_string(&ssd, "Desmontando", 10, 20);
@@ -179,6 +328,7 @@ int main() {
                 run_unmount();
                 sleep_ms(1000);
             } else {
+                set_led_color("init");
                 ssd1306_fill(&ssd, !borda);
                 ssd1306_rect(&ssd, 3, 3, 122, 60, borda, !borda);
                 ssd1306_draw_string(&ssd, "Montando", 10, 20);
@@ -197,13 +347,13 @@ int main() {
             ssd1306_draw_string(&ssd, "arquivos...", 30, 30);
             ssd1306_send_data(&ssd);
             buzzer_play_note(1200, 80);
-            sleep_ms(1000);
+            ui_pause_ms(1000);
             printf("\nListagem de arquivos no cartão SD.\n");
             run_ls();
             set_led_color("sd_rw");
             printf("\nListagem concluída.\n");
             printf("\nEscolha o comando (h = help):  ");
-            sleep_ms(1000);
+            ui_pause_ms(1000);
         }
         else if (cRxedChar == 'd') {
             ssd1306_fill(&ssd, !borda);
@@ -212,10 +362,10 @@ int main() {
             ssd1306_draw_string(&ssd, "arquivo...", 30, 30);
             ssd1306_send_data(&ssd);
             buzzer_play_note(1200, 80);
-            sleep_ms(1000);
+            ui_pause_ms(1000);
             read_file(filename);
             set_led_color("sd_rw");
-            sleep_ms(1000);
+            ui_pause_ms(1000);
             printf("Escolha o comando (h = help):  ");
         }
         else if (cRxedChar == 'e') {
@@ -226,18 +376,15 @@ int main() {
             ssd1306_send_data(&ssd);
             buzzer_play_note(1200, 80);
             printf("\nObtendo espaço livre no SD.\n\n");
-            sleep_ms(1000);
+            ui_pause_ms(1000);
             run_getfree();
             set_led_color("sd_rw");
-            sleep_ms(1000);
+            ui_pause_ms(1000);
             printf("\nEspaço livre obtido.\n");
             printf("\nEscolha o comando (h = help):  ");
         }
         else if (logger_enabled && !recording) {
-            recording = true;
-            capture_mpu6050_data_and_save();
-            recording = false;
-            sleep_ms(1000);
+            capture_start();
         }
         else if (cRxedChar == 'g') {
             ssd1306_fill(&ssd, !borda);
@@ -245,16 +392,16 @@ int main() {
             ssd1306_draw_string(&ssd, "Formatando...", 10, 20);
             ssd1306_send_data(&ssd);
             printf("\nProcesso de formatação do SD iniciado. Aguarde...\n");
-            sleep_ms(1000);
+            ui_pause_ms(1000);
             run_format();
-            sleep_ms(1000);
+            ui_pause_ms(1000);
             printf("\nFormatação concluída.\n\n");
             printf("\nEscolha o comando (h = help):  ");
         }
         else if (cRxedChar == 'h') {
             run_help();
         }
-        else {
+        else if (!recording) {
             if (montado) {
                 set_led_color("pronto");
                 ssd1306_fill(&ssd, !borda);
@@ -273,7 +420,8 @@ int main() {
                 ssd1306_send_data(&ssd);
             }
         }
-        sleep_ms(500);
+        if (!recording)
+            sleep_ms(500);
     }
     return 0;
 }
@@ -368,12 +516,51 @@ void beep(int count)
         sleep_ms(150);                       // Pequena pausa entre beeps
     }
 }
+// Pausa da interface entre os passos de um comando. Durante a gravação não
+// pausa: o núcleo 0 precisa voltar logo a drenar o anel
+static void ui_pause_ms(uint32_t ms)
+{
+    if (!recording)
+        sleep_ms(ms);
+}
 void buzzer_init()
 {
     gpio_init(BUZZER_PIN);
     gpio_set_dir(BUZZER_PIN, GPIO_OUT);
 }
 
+static void mpu6050_bus_init()
+{
+    // Inicialização do I2C para comunicação com MPU6050
+    i2c_init(I2C_PORT, 400 * 1000);
+    gpio_set_function(I2C_SDA, GPIO_FUNC_I2C);
+    gpio_set_function(I2C_SCL, GPIO_FUNC_I2C);
+    gpio_pull_up(I2C_SDA);
+    gpio_pull_up(I2C_SCL);
+    mpu6050_reset();
+    i2c_dma_init(&mpu_dma, I2C_PORT, DMA_IRQ_1); // DMA_IRQ_0 fica com o SPI do cartão SD
+
+    // Pino INT do sensor. O tratador "raw" é exclusivo deste pino e convive com
+    // o callback debounce() dos botões, que continua sendo o callback GPIO do núcleo 0.
+    gpio_init(MPU6050_INT_PIN);
+    gpio_set_dir(MPU6050_INT_PIN, GPIO_IN);
+    gpio_pull_down(MPU6050_INT_PIN);
+    gpio_add_raw_irq_handler(MPU6050_INT_PIN, mpu6050_int_irq_handler);
+    irq_set_enabled(IO_IRQ_BANK0, true);
+}
+
+static void mpu6050_write_reg(uint8_t reg, uint8_t value)
+{
+    uint8_t buf[] = {reg, value};
+    i2c_write_blocking(I2C_PORT, addr, buf, 2, false);
+}
+
+static void mpu6050_read_regs(uint8_t reg, uint8_t *buffer, size_t len)
+{
+    i2c_write_blocking(I2C_PORT, addr, &reg, 1, true);
+    i2c_read_blocking(I2C_PORT, addr, buffer, len, false);
+}
+
 static void mpu6050_reset()
 {
     uint8_t buf[] = {0x6B, 0x80};
@@ -382,6 +569,44 @@ static void mpu6050_reset()
     buf[1] = 0x00;
     i2c_write_blocking(I2C_PORT, addr, buf, 2, false);
     sleep_ms(10);
+
+    // Configuração completa: clock do PLL do giroscópio X, DLPF, faixas de
+    // ±2 g (16384 LSB/g) e ±250 °/s (131 LSB/(°/s)), FIFO desligada
+    mpu6050_write_reg(MPU6050_PWR_MGMT_1, 0x01);
+    mpu6050_write_reg(MPU6050_CONFIG, MPU6050_DLPF_CFG);
+    mpu6050_write_reg(MPU6050_GYRO_CONFIG, MPU6050_GYRO_FS_SEL << 3);
+    mpu6050_write_reg(MPU6050_ACCEL_CONFIG, MPU6050_ACCEL_FS_SEL << 3);
+    mpu6050_configure(SAMPLE_RATE_HZ, IMU_MODE_POLL);
+}
+
+// Ajusta a taxa interna do sensor e prepara a FIFO ou a interrupção de
+// data-ready conforme o modo. Retorna a taxa efetiva (1 kHz dividido por um inteiro).
+static uint32_t mpu6050_configure(uint32_t rate_hz, imu_mode_t mode)
+{
+    uint8_t div = 1000 / rate_hz - 1;
+    mpu6050_write_reg(MPU6050_SMPLRT_DIV, div);
+
+    mpu6050_write_reg(MPU6050_FIFO_EN, 0x00);
+    mpu6050_write_reg(MPU6050_USER_CTRL, MPU6050_USER_CTRL_FIFO_RESET);
+    if (mode == IMU_MODE_FIFO)
+    {
+        mpu6050_write_reg(MPU6050_INT_ENABLE, MPU6050_INT_FIFO_OFLOW);
+        uint8_t status;
+        mpu6050_read_regs(MPU6050_INT_STATUS, &status, 1); // Limpa estouro antigo
+        mpu6050_write_reg(MPU6050_USER_CTRL, MPU6050_USER_CTRL_FIFO_EN | MPU6050_USER_CTRL_FIFO_RESET);
+        mpu6050_write_reg(MPU6050_FIFO_EN, MPU6050_FIFO_EN_ACCEL_GYRO);
+    }
+    else if (mode == IMU_MODE_IRQ)
+    {
+        // Pulso ativo em nível alto de 50 us, limpo pela leitura dos dados
+        mpu6050_write_reg(MPU6050_INT_PIN_CFG, MPU6050_INT_RD_CLEAR);
+        mpu6050_write_reg(MPU6050_INT_ENABLE, MPU6050_INT_DATA_RDY);
+    }
+    else
+    {
+        mpu6050_write_reg(MPU6050_INT_ENABLE, 0x00);
+    }
+    return 1000 / (div + 1);
 }
 
 static void mpu6050_read_raw(int16_t accel[3], int16_t gyro[3], int16_t *temp)
@@ -405,6 +630,348 @@ static void mpu6050_read_raw(int16_t accel[3], int16_t gyro[3], int16_t *temp)
     *temp = (buffer[0] << 8) | buffer[1];
 }
 
+// Leitura em rajada: ACCEL_XOUT_H (0x3B) até GYRO_ZOUT_L (0x48) são contíguos,
+// então um write do endereço + repeated start + 14 bytes traz os sete canais
+static void mpu6050_read_burst(int16_t accel[3], int16_t gyro[3], int16_t *temp)
+{
+    uint8_t buffer[14];
+    uint8_t val = 0x3B;
+    i2c_write_blocking(I2C_PORT, addr, &val, 1, true);
+    i2c_read_blocking(I2C_PORT, addr, buffer, 14, false);
+    for (int i = 0; i < 3; i++)
+    {
+        accel[i] = (buffer[i * 2] << 8) | buffer[(i * 2) + 1];
+        gyro[i] = (buffer[8 + i * 2] << 8) | buffer[8 + (i * 2) + 1];
+    }
+    *temp = (buffer[6] << 8) | buffer[7];
+}
+
+// Resultado do 'imubench', preenchido no núcleo dono do sensor
+typedef struct {
+    uint32_t min, max;
+    uint64_t total;
+} imu_bench_result_t;
+static imu_bench_result_t imu_bench_results[2]; // [0] três leituras, [1] rajada
+static uint32_t imu_bench_iterations;
+
+// Mede em ciclos de clock os dois caminhos de leitura usando o SysTick do
+// núcleo atual (24 bits, conta para baixo no clock do processador)
+static bool imu_bench(uint32_t iterations)
+{
+    int16_t acc[3], gyro[3], temp;
+
+    systick_hw->rvr = 0x00FFFFFF;
+    systick_hw->cvr = 0;
+    systick_hw->csr = 0x5; // CLKSOURCE = processador, ENABLE = 1, sem interrupção
+    for (int path = 0; path < 2; path++)
+    {
+        imu_bench_result_t *r = &imu_bench_results[path];
+        r->min = UINT32_MAX;
+        r->max = 0;
+        r->total = 0;
+        for (uint32_t i = 0; i < iterations; i++)
+        {
+            uint32_t start = systick_hw->cvr;
+            if (path)
+                mpu6050_read_burst(acc, gyro, &temp);
+            else
+                mpu6050_read_raw(acc, gyro, &temp);
+            uint32_t cycles = (start - systick_hw->cvr) & 0x00FFFFFF;
+            if (cycles < r->min)
+                r->min = cycles;
+            if (cycles > r->max)
+                r->max = cycles;
+            r->total += cycles;
+        }
+    }
+    imu_bench_iterations = iterations;
+    return true;
+}
+
+#if MPU6050_BURST_READ
+static uint8_t sample_raw[MPU6050_DATA_LEN]; // Destino do DMA da leitura em andamento
+static imu_sample_t *sample_slot;            // Posição reservada no anel para ela
+
+// Fim da rajada por DMA: converte os bytes e publica a amostra
+static void sample_read_done(bool ok, void *ctx)
+{
+    if (!ok)
+    {
+        sample_ring_overflow(&sample_ring, 1); // NACK ou timeout: amostra perdida
+        return;
+    }
+    for (int i = 0; i < 3; i++)
+    {
+        sample_slot->accel[i] = (sample_raw[i * 2] << 8) | sample_raw[i * 2 + 1];
+        sample_slot->gyro[i] = (sample_raw[8 + i * 2] << 8) | sample_raw[8 + i * 2 + 1];
+    }
+    sample_ring_commit(&sample_ring, 1);
+}
+#endif
+
+// Lê uma amostra do sensor direto no anel.
+// Roda em contexto de interrupção, portanto não acessa o SD nem o display.
+// Na rajada por DMA só dispara a leitura; sample_read_done() a conclui.
+static void sampler_read_sample()
+{
+    uint32_t n = 1;
+#if MPU6050_BURST_READ
+    if (i2c_dma_busy(&mpu_dma))
+    {
+        sample_ring_overflow(&sample_ring, 1); // Leitura anterior ainda no barramento
+        return;
+    }
+#endif
+    imu_sample_t *slot = sample_ring_reserve(&sample_ring, &n);
+    if (!n)
+    {
+        sample_ring_overflow(&sample_ring, 1); // Gravador atrasado: amostra perdida
+        return;
+    }
+    slot->timestamp_us = time_us_32();
+#if MPU6050_BURST_READ
+    sample_slot = slot;
+    if (!i2c_dma_read_regs_async(&mpu_dma, addr, 0x3B, sample_raw, MPU6050_DATA_LEN, sample_read_done, NULL))
+        sample_ring_overflow(&sample_ring, 1);
+#else
+    int16_t temp;
+    TRACE_BEGIN(TRACE_EV_I2C_READ);
+    mpu6050_read_raw(slot->accel, slot->gyro, &temp);
+    TRACE_END(TRACE_EV_I2C_READ);
+    sample_ring_commit(&sample_ring, 1);
+#endif
+}
+
+// Callback do timer de hardware no modo 'poll'
+static bool sampler_timer_callback(repeating_timer_t *rt)
+{
+    sampler_read_sample();
+    return true; // Mantém o timer ativo
+}
+
+// Modo 'irq': a borda de subida do INT marca um novo conjunto de registradores,
+// então cada amostra é lida exatamente uma vez e logo após ser produzida
+static void mpu6050_int_irq_handler()
+{
+    if (gpio_get_irq_event_mask(MPU6050_INT_PIN) & GPIO_IRQ_EDGE_RISE)
+    {
+        gpio_acknowledge_irq(MPU6050_INT_PIN, GPIO_IRQ_EDGE_RISE);
+        sampler_read_sample();
+    }
+}
+
+// Modo FIFO: o sensor amostra na própria taxa e o timer recolhe, em uma
+// única rajada I2C, todos os quadros completos acumulados desde o último.
+// Cada etapa (INT_STATUS, FIFO_COUNT, dados, ou o reset após um estouro) é
+// uma transferência por DMA cujo callback dispara a seguinte, então o timer
+// retorna imediatamente.
+static uint8_t fifo_buf[FIFO_SIZE];
+static uint8_t fifo_reg_buf[2];
+static uint32_t fifo_frames;
+static uint32_t fifo_drain_t_us; // Instante da drenagem: o último quadro é deste momento
+static uint32_t fifo_empty_t_us; // Última vez em que a FIFO ficou vazia (drenada ou zerada)
+static volatile bool fifo_reset_pending; // Estouro visto; a FIFO precisa ser zerada
+static const uint8_t fifo_reset_value = MPU6050_USER_CTRL_FIFO_EN | MPU6050_USER_CTRL_FIFO_RESET;
+
+static void fifo_data_done(bool ok, void *ctx)
+{
+    fifo_empty_t_us = fifo_drain_t_us;
+    if (!ok)
+    {
+        sample_ring_overflow(&sample_ring, fifo_frames);
+        return;
+    }
+
+    // O último quadro é o mais recente; os anteriores estão um período atrás cada
+    const uint8_t *frame = fifo_buf;
+    uint32_t remaining = fifo_frames;
+    while (remaining)
+    {
+        uint32_t n = remaining;
+        imu_sample_t *slot = sample_ring_reserve(&sample_ring, &n);
+        if (!n)
+        {
+            sample_ring_overflow(&sample_ring, remaining);
+            break;
+        }
+        for (uint32_t i = 0; i < n; i++, slot++, frame += FIFO_FRAME_SIZE)
+        {
+            slot->timestamp_us = fifo_drain_t_us - (remaining - 1 - i) * fifo_period_us;
+            for (int j = 0; j < 3; j++)
+            {
+                slot->accel[j] = (frame[j * 2] << 8) | frame[j * 2 + 1];
+                slot->gyro[j] = (frame[6 + j * 2] << 8) | frame[6 + j * 2 + 1];
+            }
+        }
+        sample_ring_commit(&sample_ring, n);
+        remaining -= n;
+    }
+}
+
+static void fifo_count_done(bool ok, void *ctx)
+{
+    if (!ok)
+        return;
+    fifo_frames = (((uint32_t)fifo_reg_buf[0] << 8) | fifo_reg_buf[1]) / FIFO_FRAME_SIZE;
+    if (fifo_frames)
+        i2c_dma_read_regs_async(&mpu_dma, addr, MPU6050_FIFO_R_W, fifo_buf, fifo_frames * FIFO_FRAME_SIZE,
+                                fifo_data_done, NULL);
+    else
+        fifo_empty_t_us = fifo_drain_t_us;
+}
+
+static void fifo_reset_done(bool ok, void *ctx)
+{
+    if (ok)
+        fifo_reset_pending = false; // Senão o próximo disparo do timer tenta de novo
+}
+
+static void fifo_status_done(bool ok, void *ctx)
+{
+    if (!ok)
+        return;
+    if (fifo_reg_buf[0] & MPU6050_INT_FIFO_OFLOW)
+    {
+        // Quadros sobrescritos: o alinhamento é incerto, então recomeça do zero.
+        // O reset descarta tudo o que o sensor produziu desde que a FIFO
+        // ficou vazia, e isso entra nas perdas do anel.
+        fifo_overflows++;
+        sample_ring_overflow(&sample_ring, (fifo_drain_t_us - fifo_empty_t_us) / fifo_period_us);
+        fifo_empty_t_us = fifo_drain_t_us;
+        fifo_reset_pending = true;
+        i2c_dma_write_regs_async(&mpu_dma, addr, MPU6050_USER_CTRL, &fifo_reset_value, 1, fifo_reset_done, NULL);
+        return;
+    }
+    i2c_dma_read_regs_async(&mpu_dma, addr, MPU6050_FIFO_COUNTH, fifo_reg_buf, 2, fifo_count_done, NULL);
+}
+
+static bool fifo_drain_callback(repeating_timer_t *rt)
+{
+    if (i2c_dma_busy(&mpu_dma))
+        return true; // Drenagem anterior ainda em andamento; os quadros esperam na FIFO
+    if (fifo_reset_pending)
+    {
+        i2c_dma_write_regs_async(&mpu_dma, addr, MPU6050_USER_CTRL, &fifo_reset_value, 1, fifo_reset_done, NULL);
+        return true;
+    }
+    fifo_drain_t_us = time_us_32();
+    i2c_dma_read_regs_async(&mpu_dma, addr, MPU6050_INT_STATUS, fifo_reg_buf, 1, fifo_status_done, NULL);
+    return true;
+}
+
+// Soma os contadores do anel aos totais do 'stats' antes de zerá-los
+static void logger_stats_fold()
+{
+    logger_stats.samples += sample_ring_total(&sample_ring) - logger_stats.samples_base;
+    logger_stats.drops += sample_ring_overflows(&sample_ring) - logger_stats.drops_base;
+    if (sample_ring_high_watermark(&sample_ring) > logger_stats.high_watermark)
+        logger_stats.high_watermark = sample_ring_high_watermark(&sample_ring);
+    logger_stats.samples_base = logger_stats.drops_base = 0;
+}
+
+static bool sampler_start(uint32_t rate_hz)
+{
+    logger_stats_fold();
+    sample_ring_reset(&sample_ring); // Descarta amostras de uma gravação anterior
+    fifo_overflows = 0;
+
+    if (imu_mode == IMU_MODE_FIFO)
+    {
+        fifo_period_us = 1000000 / mpu6050_configure(rate_hz, IMU_MODE_FIFO);
+        fifo_empty_t_us = time_us_32();
+        fifo_reset_pending = false;
+        // Drena com a FIFO pela metade: ~425 ms a 100 Hz, ~42 ms a 1 kHz
+        int64_t drain_us = (int64_t)(FIFO_SIZE / FIFO_FRAME_SIZE) * fifo_period_us / 2;
+        return alarm_pool_add_repeating_timer_us(sampler_pool, -drain_us,
+                                                 fifo_drain_callback, NULL, &sample_timer);
+    }
+    if (imu_mode == IMU_MODE_IRQ)
+    {
+        mpu6050_configure(rate_hz, IMU_MODE_IRQ);
+        gpio_acknowledge_irq(MPU6050_INT_PIN, GPIO_IRQ_EDGE_RISE);
+        gpio_set_irq_enabled(MPU6050_INT_PIN, GPIO_IRQ_EDGE_RISE, true);
+        return true;
+    }
+    mpu6050_configure(rate_hz, IMU_MODE_POLL);
+
+    // Período negativo: o intervalo conta a partir do início do disparo anterior,
+    // então o tempo gasto no callback não acumula atraso
+    return alarm_pool_add_repeating_timer_us(sampler_pool, -(int64_t)(1000000 / rate_hz),
+                                             sampler_timer_callback, NULL, &sample_timer);
+}
+
+static void sampler_stop()
+{
+    if (imu_mode == IMU_MODE_IRQ)
+    {
+        gpio_set_irq_enabled(MPU6050_INT_PIN, GPIO_IRQ_EDGE_RISE, false);
+        i2c_dma_wait(&mpu_dma, SAMPLER_DRAIN_TIMEOUT_US);
+        mpu6050_configure(SAMPLE_RATE_HZ, IMU_MODE_POLL);
+        return;
+    }
+    cancel_repeating_timer(&sample_timer);
+    i2c_dma_wait(&mpu_dma, SAMPLER_DRAIN_TIMEOUT_US); // Conclui a leitura em andamento
+    if (imu_mode == IMU_MODE_FIFO)
+    {
+        // Recolhe o que ficou na FIFO. A cadeia de callbacks roda inteira dentro
+        // da interrupção do DMA, então só parece ociosa depois da última etapa.
+        fifo_drain_callback(&sample_timer);
+        i2c_dma_wait(&mpu_dma, SAMPLER_DRAIN_TIMEOUT_US);
+        mpu6050_configure(SAMPLE_RATE_HZ, IMU_MODE_POLL);
+    }
+}
+
+// Núcleo 1: dono do I2C0 e do MPU6050. O pool de alarmes criado aqui faz o
+// callback do timer rodar neste núcleo; o núcleo 0 só envia comandos pela FIFO.
+static void core1_entry()
+{
+    mpu6050_bus_init();
+    sampler_pool = alarm_pool_create_with_unused_hardware_alarm(4);
+
+    while (true)
+    {
+        uint32_t cmd = multicore_fifo_pop_blocking();
+        bool ok = true;
+        switch (cmd & CORE1_CMD_MASK)
+        {
+        case CORE1_CMD_START:
+            ok = sampler_start(cmd & ~CORE1_CMD_MASK);
+            break;
+        case CORE1_CMD_STOP:
+            sampler_stop();
+            break;
+        case CORE1_CMD_BENCH:
+            ok = imu_bench(cmd & ~CORE1_CMD_MASK);
+            break;
+        default:
+            ok = false;
+            break;
+        }
+        multicore_fifo_push_blocking(ok);
+    }
+}
+
+// Inicia a amostragem no núcleo dono do sensor
+static bool sampler_request_start(uint32_t rate_hz)
+{
+#if MULTICORE_MODE
+    multicore_fifo_push_blocking(CORE1_CMD_START | rate_hz);
+    return multicore_fifo_pop_blocking();
+#else
+    return sampler_start(rate_hz);
+#endif
+}
+
+static void sampler_request_stop()
+{
+#if MULTICORE_MODE
+    multicore_fifo_push_blocking(CORE1_CMD_STOP);
+    multicore_fifo_pop_blocking(); // Após a resposta nenhuma amostra nova entra no anel
+#else
+    sampler_stop();
+#endif
+}
+
 static sd_card_t *sd_get_by_name(const char *const name)
 {
     for (size_t i = 0; i < sd_get_num(); ++i)
@@ -485,6 +1052,11 @@ static void run_setrtc()
 
 static void run_format()
 {
+    if (recording)
+    {
+        printf("Pare a gravação antes de formatar o SD\n");
+        return;
+    }
     const char *arg1 = strtok(NULL, " ");
     if (!arg1)
         arg1 = sd_get_by_num(0)->pcName;
@@ -507,6 +1079,11 @@ static void run_format()
     }
     else
     {
+        // O f_mkfs alinha a área de dados ao GET_BLOCK_SIZE, que vem da AU do cartão
+        sd_card_t *pSD = sd_get_by_name(arg1);
+        uint32_t au = pSD ? sd_allocation_unit(pSD) : 0;
+        if (au)
+            printf("Área de dados alinhada à unidade de alocação do cartão (%lu KiB)\n", (unsigned long)au / 2);
         buzzer_play_note(1000, 150);
         buzzer_play_note(700, 150);
         buzzer_play_note(500, 200);
@@ -552,9 +1129,15 @@ static void run_mount()
     pSD->mounted = true;
     montado = true;
     printf("Processo de montagem do SD ( %s ) concluído\n", pSD->pcName);
+    printf("SPI do SD negociado em %lu Hz\n", (unsigned long)pSD->baud_rate);
 }
 static void run_unmount()
 {
+    if (recording)
+    {
+        printf("Pare a gravação antes de desmontar o SD\n");
+        return;
+    }
     const char *arg1 = strtok(NULL, " ");
     if (!arg1)
         arg1 = sd_get_by_num(0)->pcName;
@@ -564,6 +1147,10 @@ static void run_unmount()
         printf("Unknown logical drive number: \"%s\"\n", arg1);
         return;
     }
+    // Confere o status deixado pendente pela política do CMD13 antes de soltar o cartão
+    DRESULT dr = disk_ioctl(p_fs->pdrv, CTRL_SYNC, NULL);
+    if (RES_OK != dr)
+        printf("O cartão reportou erro de escrita (%d)\n", dr);
     FRESULT fr = f_unmount(arg1);
     if (FR_OK != fr)
     {
@@ -683,17 +1270,40 @@ static void run_ls()
         else
             pcAttrib = pcWritableFile;
         printf("%s [%s] [size=%llu]\n", fno.fname, pcAttrib, fno.fsize);
+        capture_keep_alive();
 
         fr = f_findnext(&dj, &fno);
     }
     f_closedir(&dj);
     gpio_put(led_red, 1);
     gpio_put(led_blue, 1);
-    sleep_ms(200);
+    ui_pause_ms(200);
     gpio_put(led_red, 0);
     gpio_put(led_blue, 0);
-    sleep_ms(200);
+    ui_pause_ms(200);
 }
+// Buffer da leitura em fluxo: o cartão enche uma metade por CMD18 enquanto
+// a outra segue para a USB
+static uint8_t stream_buf[STREAM_BUF_SIZE] __attribute__((aligned(4)));
+
+// Sink do f_stream(): envia o pedaço em fwrites médios e, entre eles, deixa
+// a leitura da outra metade avançar no cartão
+static bool stream_to_usb(const void *data, size_t len, void *ctx)
+{
+    (void)ctx;
+    const char *p = data;
+    while (len)
+    {
+        size_t k = len < STREAM_USB_PIECE ? len : STREAM_USB_PIECE;
+        fwrite(p, 1, k, stdout);
+        p += k;
+        len -= k;
+        disk_async_poll();
+        capture_keep_alive();
+    }
+    return true;
+}
+
 static void run_cat()
 {
     char *arg1 = strtok(NULL, " ");
@@ -709,24 +1319,245 @@ static void run_cat()
         printf("f_open error: %s (%d)\n", FRESULT_str(fr), fr);
         return;
     }
-    char buf[256];
-    while (f_gets(buf, sizeof buf, &fil))
-    {
-        printf("%s", buf);
-    }
+    // O conteúdo vai direto para a USB: não há linhas a separar
+    fr = f_stream(&fil, stream_buf, sizeof stream_buf, stream_to_usb, NULL);
+    fflush(stdout);
+    if (FR_OK != fr)
+        printf("f_read error: %s (%d)\n", FRESULT_str(fr), fr);
     fr = f_close(&fil);
     if (FR_OK != fr)
         printf("f_open error: %s (%d)\n", FRESULT_str(fr), fr);
 }
 
-void capture_mpu6050_data_and_save()
+_Static_assert(LOG_STAGING_SIZE >= 4 * 1024 && LOG_STAGING_SIZE <= 32 * 1024 && LOG_STAGING_SIZE % 512 == 0,
+               "LOG_STAGING_SIZE deve ser múltiplo de 512 entre 4 e 32 KiB");
+
+// Buffers de gravação. O cabeçalho entra no início do primeiro bloco, então
+// toda descarga completa começa num múltiplo de LOG_STAGING_SIZE do início do
+// arquivo (que é início de cluster): o f_write vai direto para o cartão, sem
+// passar pelo buffer de setor do FatFs, em escritas multibloco (CMD25) de até
+// um cluster cada.
+//
+// Com o arquivo pré-alocado são dois buffers: enquanto um é gravado pela fila
+// assíncrona (disk_write_async), as amostras seguintes enchem o outro.
+static uint8_t log_staging[2][LOG_STAGING_SIZE] __attribute__((aligned(4)));
+static uint32_t log_staging_len;
+static uint8_t log_fill;                // Buffer sendo preenchido
+static volatile bool log_in_flight[2];  // Buffer entregue à fila e ainda não gravado
+static uint32_t log_async_errors;
+static FRESULT log_error; // Primeira falha de escrita da gravação atual
+static DWORD log_clmt[LOG_CLMT_SIZE]; // Mapa de clusters do arquivo pré-alocado
+
+// Escrita direta na área pré-alocada: o arquivo é contíguo, então o byte n
+// está no setor log_raw_lba + n / 512 e o FatFs não precisa participar
+static bool log_raw;
+static LBA_t log_raw_lba;
+static FSIZE_t log_raw_bytes; // Já entregues à fila, sempre múltiplo de LOG_STAGING_SIZE
+
+static void log_write_done(DRESULT result, void *ctx)
+{
+    if (RES_OK != result)
+    {
+        log_async_errors++;
+        logger_stats.write_errors++;
+    }
+    *(volatile bool *)ctx = false;
+}
+
+// Primeira falha de escrita da gravação: avisa e pede o fim da gravação, que
+// o laço principal faz com capture_stop(). Daí em diante log_flush() descarta
+// os blocos em vez de insistir num cartão cheio ou com defeito.
+static void log_fail(FRESULT fr, const char *what)
+{
+    if (FR_OK != log_error)
+        return;
+    log_error = fr;
+    logger_enabled = false;
+    printf("\n[ERRO] %s: %s (%d). Gravação interrompida.\n", what, FRESULT_str(fr), fr);
+}
+
+// Sai do modo direto: espera a fila e posiciona o FIL logo após o que ela
+// gravou, para o resto seguir pelo f_write
+static void log_leave_raw(FIL *file)
+{
+    if (!log_raw)
+        return;
+    disk_async_flush(); // Falhas já contadas por log_write_done
+    log_raw = false;
+    FRESULT fr = f_lseek(file, log_raw_bytes);
+    if (FR_OK != fr)
+    {
+        logger_stats.write_errors++;
+        log_fail(fr, "f_lseek");
+    }
+}
+
+static void log_flush(FIL *file)
 {
-    FIL file;
     UINT bw;
-    int count = 0;
-    int16_t acc[3], gyro[3], temp;
+    if (!log_staging_len)
+        return;
+    if (FR_OK != log_error)
+    {
+        log_staging_len = 0;
+        return;
+    }
+    if (log_raw && log_staging_len == LOG_STAGING_SIZE && log_raw_bytes + LOG_STAGING_SIZE <= f_size(file))
+    {
+        BYTE pdrv = file->obj.fs->pdrv;
+        DRESULT dr;
+        log_in_flight[log_fill] = true;
+        while (RES_NOTRDY == (dr = disk_write_async(pdrv, log_staging[log_fill], log_raw_lba + log_raw_bytes / 512,
+                                                    LOG_STAGING_SIZE / 512, log_write_done,
+                                                    (void *)&log_in_flight[log_fill])))
+            disk_async_poll();
+        if (RES_OK != dr) // Recusado pela fila: o callback não será chamado
+        {
+            log_in_flight[log_fill] = false;
+            log_async_errors++;
+            logger_stats.write_errors++;
+        }
+        else
+        {
+            log_raw_bytes += LOG_STAGING_SIZE;
+            log_fill ^= 1;
+            // Só espera se o cartão ainda não terminou o buffer anterior
+            while (log_in_flight[log_fill])
+                disk_async_poll();
+        }
+        log_staging_len = 0;
+        if (log_async_errors)
+            log_fail(FR_DISK_ERR, "Escrita no cartão");
+        return;
+    }
+    // Bloco parcial (fim da gravação) ou área reservada esgotada
+    log_leave_raw(file);
+    // O mapa de fast seek só cobre a área reservada; além dela o FatFs volta a
+    // alocar clusters pela FAT
+    if (file->cltbl && f_tell(file) + log_staging_len > f_size(file))
+        file->cltbl = NULL;
+    TRACE_BEGIN(TRACE_EV_F_WRITE);
+    FRESULT fr = f_write(file, log_staging[log_fill], log_staging_len, &bw);
+    TRACE_END(TRACE_EV_F_WRITE);
+    if (FR_OK != fr || bw < log_staging_len)
+    {
+        logger_stats.write_errors++;
+        log_fail(FR_OK != fr ? fr : FR_DENIED, "f_write"); // bw curto: cartão cheio
+    }
+    log_staging_len = 0;
+}
+
+// Estágio de armazenamento: converte todas as amostras já no anel em registros
+// binários (imu_log_record_t) no buffer de gravação e descarrega cada bloco
+// cheio. A conversão é só trocar o instante absoluto pelo intervalo desde a
+// amostra anterior.
+static void write_pending_samples(FIL *file, uint32_t *count, uint32_t *last_us)
+{
+    for (;;)
+    {
+        uint32_t n = (LOG_STAGING_SIZE - log_staging_len) / sizeof(imu_log_record_t);
+        const imu_sample_t *s = sample_ring_peek(&sample_ring, &n);
+        if (!n)
+            break;
+        imu_log_record_t *r = (imu_log_record_t *)&log_staging[log_fill][log_staging_len];
+        TRACE_BEGIN(TRACE_EV_CONVERT);
+        for (uint32_t i = 0; i < n; i++, s++, r++)
+        {
+            if (*count == 0)
+                *last_us = s->timestamp_us;
+            r->dt_us = s->timestamp_us - *last_us;
+            *last_us = s->timestamp_us;
+            memcpy(r->accel, s->accel, sizeof(r->accel));
+            memcpy(r->gyro, s->gyro, sizeof(r->gyro));
+            ++*count;
+        }
+        TRACE_END(TRACE_EV_CONVERT);
+        sample_ring_release(&sample_ring, n);
+        log_staging_len += n * sizeof(imu_log_record_t);
+        if (log_staging_len == LOG_STAGING_SIZE)
+            log_flush(file);
+    }
+}
+
+// Primeiro setor de um arquivo contíguo (f_expand devolve clusters consecutivos)
+static LBA_t contiguous_file_lba(const FIL *file)
+{
+    const FATFS *fs = file->obj.fs;
+    return fs->database + (LBA_t)fs->csize * (file->obj.sclust - 2);
+}
 
-    FRESULT res = f_open(&file, filename, FA_WRITE | FA_CREATE_ALWAYS);
+// Reserva uma área contígua para prealloc_seconds de gravação. As escritas
+// então caem em LBAs consecutivos: o mapa de fast seek (CLMT) dispensa a
+// leitura da FAT a cada cluster e não há alocação durante a gravação.
+static bool log_preallocate(FIL *file)
+{
+    if (!prealloc_seconds)
+        return false;
+    FSIZE_t size = sizeof(imu_log_header_t) +
+                   (FSIZE_t)sample_rate_hz * prealloc_seconds * sizeof(imu_log_record_t);
+    size = (size + LOG_STAGING_SIZE - 1) / LOG_STAGING_SIZE * LOG_STAGING_SIZE;
+
+    FRESULT fr = f_expand(file, size, 1);
+    if (FR_OK != fr)
+    {
+        printf("Sem %lu KiB contíguos no cartão (%s): gravando com alocação dinâmica\n",
+               (unsigned long)(size / 1024), FRESULT_str(fr));
+        return false;
+    }
+    log_clmt[0] = LOG_CLMT_SIZE;
+    file->cltbl = log_clmt;
+    fr = f_lseek(file, CREATE_LINKMAP);
+    if (FR_OK != fr)
+        file->cltbl = NULL; // Continua contíguo, só sem o fast seek
+
+    log_raw_lba = contiguous_file_lba(file);
+    log_raw_bytes = 0;
+    log_raw = true;
+    printf("Arquivo pré-alocado: %lu KiB contíguos\n", (unsigned long)(size / 1024));
+    return true;
+}
+
+// Cabeçalho autodescritivo com escalas, taxa, configuração do sensor e o
+// instante de início segundo o RTC
+static void fill_log_header(imu_log_header_t *h)
+{
+    memset(h, 0, sizeof(*h));
+    h->magic = IMU_LOG_MAGIC;
+    h->version = IMU_LOG_VERSION;
+    h->header_size = IMU_LOG_HEADER_SIZE;
+    h->record_size = sizeof(imu_log_record_t);
+    h->accel_lsb_per_g = MPU6050_ACCEL_LSB_PER_G;
+    h->gyro_lsb_per_dps = MPU6050_GYRO_LSB_PER_DPS;
+    h->acq_mode = imu_mode; // imu_mode_t segue a ordem de IMU_LOG_ACQ_*
+    h->dlpf_cfg = MPU6050_DLPF_CFG;
+    h->gyro_fs_sel = MPU6050_GYRO_FS_SEL;
+    h->accel_fs_sel = MPU6050_ACCEL_FS_SEL;
+    h->smplrt_div = 1000 / sample_rate_hz - 1;
+    // Nos modos fifo e irq o próprio sensor dita a taxa: 1 kHz / (1 + SMPLRT_DIV)
+    h->sample_rate_hz = imu_mode == IMU_MODE_POLL ? sample_rate_hz : 1000 / (h->smplrt_div + 1);
+
+    datetime_t t;
+    if (rtc_get_datetime(&t))
+    {
+        h->start_year = t.year;
+        h->start_month = t.month;
+        h->start_day = t.day;
+        h->start_hour = t.hour;
+        h->start_min = t.min;
+        h->start_sec = t.sec;
+    }
+}
+
+// Estado da gravação, compartilhado entre início, laço e fim
+static FIL capture_file;
+static uint32_t capture_count, capture_last_us;
+static absolute_time_t capture_next_ui;
+static bool capture_led_on;
+static bool capture_preallocated;
+
+void capture_start()
+{
+    FRESULT res = f_open(&capture_file, filename, FA_WRITE | FA_CREATE_ALWAYS);
     if (res != FR_OK)
     {
         ssd1306_fill(&ssd, !borda);                       // Limpa o display
@@ -736,47 +1567,191 @@ void capture_mpu6050_data_and_save()
         printf("Erro ao abrir o arquivo\n");
         set_led_color("erro");
         beep(3);
+        logger_enabled = false;
         return;
     }
 
-    char header[] = "numero_amostra,accel_x,accel_y,accel_z,giro_x,giro_y,giro_z\n";
-    f_write(&file, header, strlen(header), &bw);
+    log_raw = false;
+    log_fill = 0;
+    log_async_errors = 0;
+    log_error = FR_OK;
+    capture_preallocated = log_preallocate(&capture_file);
+    fill_log_header((imu_log_header_t *)log_staging[0]);
+    log_staging_len = sizeof(imu_log_header_t);
+    capture_sd_stats = sd_get_by_num(0)->stats;
 
     set_led_color("gravando");
     beep(1);
-    while (logger_enabled)
+
+    // O timer amostra em taxa fixa; o laço principal só grava e atualiza a
+    // interface, então a latência do SD não altera o instante das leituras
+    if (!sampler_request_start(sample_rate_hz))
     {
-        mpu6050_read_raw(acc, gyro, &temp);
-        float ax = acc[0] / 16384.0f, ay = acc[1] / 16384.0f, az = acc[2] / 16384.0f;
-        float gx = gyro[0] / 131.0f, gy = gyro[1] / 131.0f, gz = gyro[2] / 131.0f;
+        printf("Erro ao iniciar o timer de amostragem\n");
+        f_close(&capture_file);
+        set_led_color("erro");
+        logger_enabled = false;
+        return;
+    }
 
-        char linha[100];
-        snprintf(linha, sizeof(linha), "%d,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f\n",
-                 ++count, ax, ay, az, gx, gy, gz);
-        f_write(&file, linha, strlen(linha), &bw);
+    capture_count = 0;
+    capture_last_us = 0;
+    capture_next_ui = get_absolute_time();
+    capture_led_on = false;
+    recording = true;
+}
 
-        // Display atualização
+// Chamada a cada volta do laço principal enquanto a gravação está ativa
+void capture_mpu6050_data_and_save()
+{
+    write_pending_samples(&capture_file, &capture_count, &capture_last_us);
+    disk_async_poll(); // Avança a escrita do buffer anterior sem esperar o cartão
+
+    // Estágio de interface: display e LED em período próprio, sem bloquear
+    if (time_reached(capture_next_ui))
+    {
+        capture_next_ui = make_timeout_time_ms(UI_REFRESH_MS);
         ssd1306_fill(&ssd, 0);
         ssd1306_draw_string(&ssd, "Gravando...", 10, 20);
-        char msg[32];
-        sprintf(msg, "Amostras: %d", count);
-        ssd1306_draw_string(&ssd, msg, 10, 35);
+        char msg[2][32];
+        TRACE_BEGIN(TRACE_EV_UI_FORMAT);
+        snprintf(msg[0], sizeof(msg[0]), "Amostras: %lu", (unsigned long)capture_count);
+        snprintf(msg[1], sizeof(msg[1]), "Perdidas: %lu", (unsigned long)sample_ring_overflows(&sample_ring));
+        TRACE_END(TRACE_EV_UI_FORMAT);
+        ssd1306_draw_string(&ssd, msg[0], 10, 35);
+        ssd1306_draw_string(&ssd, msg[1], 10, 45);
+        TRACE_BEGIN(TRACE_EV_DISPLAY);
         ssd1306_send_data(&ssd);
+        TRACE_END(TRACE_EV_DISPLAY);
 
         // LED azul piscando = acesso SD
-        gpio_put(led_blue, 1);
-        sleep_ms(100);
-        gpio_put(led_blue, 0);
+        capture_led_on = !capture_led_on;
+        gpio_put(led_blue, capture_led_on);
+    }
+}
+
+// Os comandos longos do terminal (ls, cat, linebench, a leitura pelo 'd')
+// chamam isto entre um pedaço e outro: drena o anel e avança a fila, para a
+// gravação seguir enquanto eles rodam
+static void capture_keep_alive()
+{
+    if (!recording)
+        return;
+    write_pending_samples(&capture_file, &capture_count, &capture_last_us);
+    disk_async_poll();
+}
 
-        sleep_ms(500);
+void capture_stop()
+{
+    sampler_request_stop();
+    write_pending_samples(&capture_file, &capture_count, &capture_last_us); // Grava o que restou no anel
+    log_flush(&capture_file);
+    log_leave_raw(&capture_file); // Se o último bloco estava completo
+    if (capture_preallocated)
+    {
+        capture_file.cltbl = NULL;
+        FRESULT fr = f_truncate(&capture_file); // Devolve a parte reservada que não foi usada
+        if (FR_OK != fr)
+        {
+            logger_stats.write_errors++;
+            log_fail(fr, "f_truncate");
+        }
     }
+    gpio_put(led_blue, 0);
 
-    f_close(&file);
+    FRESULT fr = f_close(&capture_file);
+    if (FR_OK != fr)
+    {
+        logger_stats.write_errors++;
+        log_fail(fr, "f_close");
+    }
+    recording = false;
+    printf("\nGravação encerrada: %lu amostras a %lu Hz, %lu perdidas\n",
+           (unsigned long)capture_count, (unsigned long)sample_rate_hz,
+           (unsigned long)sample_ring_overflows(&sample_ring));
+    printf("Ocupação máxima do anel: %lu de %lu amostras\n",
+           (unsigned long)sample_ring_high_watermark(&sample_ring),
+           (unsigned long)sample_ring_capacity(&sample_ring));
+    if (imu_mode == IMU_MODE_FIFO)
+        printf("Estouros da FIFO do MPU6050: %lu\n", (unsigned long)fifo_overflows);
+    const sd_card_stats_t *st = &sd_get_by_num(0)->stats, *st0 = &capture_sd_stats;
+    printf("Escritas no SD: %lu multibloco (CMD25), %lu bloco único (CMD24), %lu blocos\n",
+           (unsigned long)(st->multi_block_writes - st0->multi_block_writes),
+           (unsigned long)(st->single_block_writes - st0->single_block_writes),
+           (unsigned long)(st->blocks_written - st0->blocks_written));
+    if (log_async_errors)
+        printf("Erros na escrita assíncrona: %lu\n", (unsigned long)log_async_errors);
+    if (FR_OK != log_error)
+    {
+        printf("Gravação incompleta: %s (%d)\n", FRESULT_str(log_error), log_error);
+        set_led_color("erro");
+        beep(3);
+        return;
+    }
     beep(2);
     set_led_color("pronto");
 }
 
-// Função para ler o conteúdo de um arquivo e exibir no terminal
+// Estado da conversão para CSV entre dois pedaços do f_stream()
+typedef struct
+{
+    const imu_log_header_t *header;
+    uint32_t count, t_us;
+    size_t out_len;
+    char out[CSV_OUT_SIZE];
+} csv_stream_t;
+
+// Sink do f_stream() para gravações binárias. Os pedaços são múltiplos de
+// 512 bytes a partir do cabeçalho, então nenhum registro fica dividido; só o
+// último pedaço pode terminar num registro incompleto, que é ignorado.
+static bool stream_csv(const void *data, size_t len, void *ctx)
+{
+    csv_stream_t *cs = ctx;
+    const imu_log_header_t *h = cs->header;
+    const imu_log_record_t *r = data;
+    for (size_t i = 0; i < len / sizeof(imu_log_record_t); i++, r++)
+    {
+        cs->t_us += r->dt_us;
+        cs->out_len += snprintf(cs->out + cs->out_len, sizeof cs->out - cs->out_len,
+                                "%lu,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f,%lu\n", (unsigned long)++cs->count,
+                                r->accel[0] / h->accel_lsb_per_g, r->accel[1] / h->accel_lsb_per_g,
+                                r->accel[2] / h->accel_lsb_per_g, r->gyro[0] / h->gyro_lsb_per_dps,
+                                r->gyro[1] / h->gyro_lsb_per_dps, r->gyro[2] / h->gyro_lsb_per_dps,
+                                (unsigned long)cs->t_us);
+        if (cs->out_len > sizeof cs->out - 128) // Cabe sempre mais uma linha
+        {
+            fwrite(cs->out, 1, cs->out_len, stdout);
+            cs->out_len = 0;
+            disk_async_poll();
+            capture_keep_alive();
+        }
+    }
+    return true;
+}
+
+// Converte os registros de uma gravação binária para o CSV
+// numero_amostra,accel_x,...,tempo_us, já aberto após o cabeçalho
+static void print_log_as_csv(FIL *file, const imu_log_header_t *header)
+{
+    static csv_stream_t cs;
+
+    if (header->version != IMU_LOG_VERSION || header->record_size != sizeof(imu_log_record_t))
+    {
+        printf("[ERRO] Versão de arquivo não suportada: %u\n", header->version);
+        return;
+    }
+    f_lseek(file, header->header_size);
+    printf("numero_amostra,accel_x,accel_y,accel_z,giro_x,giro_y,giro_z,tempo_us\n");
+    cs.header = header;
+    cs.count = cs.t_us = 0;
+    cs.out_len = 0;
+    FRESULT fr = f_stream(file, stream_buf, sizeof stream_buf, stream_csv, &cs);
+    fwrite(cs.out, 1, cs.out_len, stdout);
+    fflush(stdout);
+    if (FR_OK != fr)
+        printf("[ERRO] Leitura interrompida: %s (%d)\n", FRESULT_str(fr), fr);
+}
+
 void read_file(const char *filename)
 {
     FIL file;
@@ -798,16 +1773,31 @@ void read_file(const char *filename)
     ssd1306_draw_string(&ssd, "SUCESSO", 10, 20);     // Desenha uma string
     ssd1306_send_data(&ssd);
     set_led_color("sd_rw");
-    char buffer[128];
     UINT br;
     printf("Conteúdo do arquivo %s:\n", filename);
-    while (f_read(&file, buffer, sizeof(buffer) - 1, &br) == FR_OK && br > 0)
+    uint64_t t0 = time_us_64();
+
+    // Gravações binárias saem como o CSV de sempre, para o script de plotagem
+    imu_log_header_t header;
+    if (f_read(&file, &header, sizeof(header), &br) == FR_OK && br == sizeof(header) &&
+        header.magic == IMU_LOG_MAGIC)
     {
-        buffer[br] = '\0';
-        printf("%s", buffer);
+        print_log_as_csv(&file, &header);
+    }
+    else
+    {
+        // Texto sai como está, em pedaços grandes, sem passar pelo printf
+        f_lseek(&file, 0);
+        FRESULT fr = f_stream(&file, stream_buf, sizeof stream_buf, stream_to_usb, NULL);
+        fflush(stdout);
+        if (FR_OK != fr)
+            printf("\n[ERRO] Leitura interrompida: %s (%d)\n", FRESULT_str(fr), fr);
     }
+    uint64_t us = time_us_64() - t0;
+    FSIZE_t size = f_size(&file);
     f_close(&file);
-    printf("\nLeitura do arquivo %s concluída.\n\n", filename);
+    printf("\nLeitura do arquivo %s concluída (%lu bytes em %.2f s, %.1f KB/s).\n\n", filename,
+           (unsigned long)size, us / 1e6f, us ? size * 1e3f / 1024 / us : 0);
 }
 
 // Trecho para modo BOOTSEL com botão B
@@ -831,6 +1821,553 @@ void debounce(uint gpio, uint32_t events)
     }
 }
 
+static void run_rate()
+{
+    const char *arg1 = strtok(NULL, " ");
+    if (!arg1)
+    {
+        printf("Taxa de amostragem: %lu Hz\n", (unsigned long)sample_rate_hz);
+        return;
+    }
+    if (recording)
+    {
+        printf("Pare a gravação antes de alterar a taxa\n");
+        return;
+    }
+    int rate = atoi(arg1);
+    if (rate < SAMPLE_RATE_MIN_HZ || rate > SAMPLE_RATE_MAX_HZ)
+    {
+        printf("Taxa inválida: use de %d a %d Hz\n", SAMPLE_RATE_MIN_HZ, SAMPLE_RATE_MAX_HZ);
+        return;
+    }
+    sample_rate_hz = rate;
+    printf("Taxa de amostragem definida em %lu Hz\n", (unsigned long)sample_rate_hz);
+}
+
+static void run_mode()
+{
+    const char *names[] = {"poll", "fifo", "irq"};
+    const char *arg1 = strtok(NULL, " ");
+    if (!arg1)
+    {
+        printf("Modo de aquisição: %s\n", names[imu_mode]);
+        return;
+    }
+    if (recording)
+    {
+        printf("Pare a gravação antes de alterar o modo\n");
+        return;
+    }
+    if (0 == strcmp(arg1, "poll"))
+        imu_mode = IMU_MODE_POLL;
+    else if (0 == strcmp(arg1, "fifo"))
+        imu_mode = IMU_MODE_FIFO;
+    else if (0 == strcmp(arg1, "irq"))
+        imu_mode = IMU_MODE_IRQ;
+    else
+    {
+        printf("Modo inválido: use poll, fifo ou irq\n");
+        return;
+    }
+    printf("Modo de aquisição definido: %s\n", names[imu_mode]);
+}
+
+// Mede comandos por segundo de uma operação do cartão
+static float spi_bench_rate(sd_card_t *pSD, bool read_block, uint32_t iterations)
+{
+    static uint8_t block[512];
+    uint64_t t0 = time_us_64();
+    for (uint32_t i = 0; i < iterations; i++)
+    {
+        if (read_block)
+            pSD->read_blocks(pSD, block, 0, 1); // CMD17
+        else
+            pSD->sd_test_com(pSD);              // CMD13
+    }
+    uint64_t dt = time_us_64() - t0;
+    return dt ? iterations * 1e6f / dt : 0;
+}
+
+static void run_spibench()
+{
+    if (recording)
+    {
+        printf("Pare a gravação antes de medir o SD\n");
+        return;
+    }
+    sd_card_t *pSD = sd_get_by_num(0);
+    if (!is_sd_mounted())
+    {
+        printf("Monte o cartão SD antes de medir\n");
+        return;
+    }
+    const char *arg1 = strtok(NULL, " ");
+    uint32_t iterations = arg1 ? (uint32_t)atoi(arg1) : SPI_BENCH_DEFAULT_ITER;
+    if (!iterations)
+    {
+        printf("Número de iterações inválido\n");
+        return;
+    }
+
+    // Limiar 1 reproduz o comportamento antigo: toda transferência por DMA
+    uint thresholds[] = {1, pSD->spi->dma_threshold};
+    float rates[2][2];
+    for (int t = 0; t < 2; t++)
+    {
+        pSD->spi->dma_threshold = thresholds[t];
+        rates[t][0] = spi_bench_rate(pSD, false, iterations);
+        rates[t][1] = spi_bench_rate(pSD, true, iterations);
+    }
+    pSD->spi->dma_threshold = thresholds[1];
+
+    printf("SPI a %lu Hz, %lu iterações:\n", (unsigned long)pSD->baud_rate, (unsigned long)iterations);
+    printf("  %-28s %10s %10s\n", "", "CMD13/s", "CMD17/s");
+    printf("  %-28s %10.0f %10.0f\n", "só DMA", rates[0][0], rates[0][1]);
+    printf("  FIFO abaixo de %3u bytes     %10.0f %10.0f\n", thresholds[1], rates[1][0], rates[1][1]);
+}
+
+static const char *sd_status_check_name(const sd_card_t *pSD)
+{
+    static char buf[24];
+    switch (pSD->status_check)
+    {
+    case SD_STATUS_CHECK_EVERY_N:
+        snprintf(buf, sizeof(buf), "a cada %lu escritas", (unsigned long)pSD->status_check_interval);
+        return buf;
+    case SD_STATUS_CHECK_ON_SYNC:
+        return "só no sync e após erro";
+    default:
+        return "a cada escrita";
+    }
+}
+
+static void run_sdcheck()
+{
+    sd_card_t *pSD = sd_get_by_num(0);
+    const char *arg1 = strtok(NULL, " ");
+    if (arg1)
+    {
+        if (recording)
+        {
+            printf("Pare a gravação antes de mudar a política\n");
+            return;
+        }
+        sd_sync(pSD); // Não deixa pendência da política anterior
+        if (!strcmp(arg1, "every"))
+            pSD->status_check = SD_STATUS_CHECK_EVERY_WRITE;
+        else if (!strcmp(arg1, "sync"))
+            pSD->status_check = SD_STATUS_CHECK_ON_SYNC;
+        else if (atoi(arg1) > 0)
+        {
+            pSD->status_check = SD_STATUS_CHECK_EVERY_N;
+            pSD->status_check_interval = atoi(arg1);
+        }
+        else
+        {
+            printf("Uso: sdcheck [every|<n>|sync]\n");
+            return;
+        }
+    }
+    printf("CMD13 após escrita: %s\n", sd_status_check_name(pSD));
+}
+
+// Tempo médio de n escritas de um setor (CMD24) em LBAs consecutivos
+static float write_bench_us(sd_card_t *pSD, LBA_t lba, uint32_t n)
+{
+    static uint8_t block[512];
+    memset(block, 0xA5, sizeof(block));
+    uint64_t t0 = time_us_64();
+    for (uint32_t i = 0; i < n; i++)
+        pSD->write_blocks(pSD, block, lba + i, 1);
+    sd_sync(pSD); // O CMD13 adiado entra na conta
+    return (float)(time_us_64() - t0) / n;
+}
+
+// Escreve setores avulsos, como o FatFs faz com FAT e diretório, dentro de um
+// arquivo temporário contíguo, para não tocar em dados do cartão
+static void run_wbench()
+{
+    if (recording)
+    {
+        printf("Pare a gravação antes de medir o SD\n");
+        return;
+    }
+    if (!is_sd_mounted())
+    {
+        printf("Monte o cartão SD antes de medir\n");
+        return;
+    }
+    const char *arg1 = strtok(NULL, " ");
+    uint32_t n = arg1 ? (uint32_t)atoi(arg1) : WRITE_BENCH_DEFAULT_N;
+    if (!n)
+    {
+        printf("Número de setores inválido\n");
+        return;
+    }
+
+    static FIL fil;
+    const char *name = "wbench.tmp";
+    FRESULT fr = f_open(&fil, name, FA_WRITE | FA_CREATE_ALWAYS);
+    if (FR_OK == fr)
+        fr = f_expand(&fil, (FSIZE_t)n * 512, 1);
+    if (FR_OK != fr)
+    {
+        printf("Erro ao reservar %s: %s (%d)\n", name, FRESULT_str(fr), fr);
+        f_close(&fil);
+        f_unlink(name);
+        return;
+    }
+    LBA_t lba = contiguous_file_lba(&fil);
+
+    sd_card_t *pSD = sd_get_by_num(0);
+    sd_status_check_t saved = pSD->status_check;
+    uint32_t saved_interval = pSD->status_check_interval;
+    static const struct {
+        sd_status_check_t policy;
+        uint32_t interval;
+    } policies[] = {{SD_STATUS_CHECK_EVERY_WRITE, 0}, {SD_STATUS_CHECK_EVERY_N, 16}, {SD_STATUS_CHECK_ON_SYNC, 0}};
+    printf("%lu escritas de um setor a %lu Hz:\n", (unsigned long)n, (unsigned long)pSD->baud_rate);
+    for (size_t i = 0; i < count_of(policies); i++)
+    {
+        pSD->status_check = policies[i].policy;
+        pSD->status_check_interval = policies[i].interval;
+        float us = write_bench_us(pSD, lba, n);
+        printf("  CMD13 %-24s %8.1f us/escrita\n", sd_status_check_name(pSD), us);
+    }
+    pSD->status_check = saved;
+    pSD->status_check_interval = saved_interval;
+
+    f_close(&fil);
+    f_unlink(name);
+}
+
+// Mede a pilha inteira (FatFs, fila, driver) com arquivos temporários e
+// acrescenta os resultados a BENCH_CSV, com a identificação do cartão em cada
+// linha, para comparar cartões e versões do driver
+static void run_bench()
+{
+    if (recording)
+    {
+        printf("Pare a gravação antes de medir o SD\n");
+        return;
+    }
+    if (!is_sd_mounted())
+    {
+        printf("Monte o cartão SD antes de medir\n");
+        return;
+    }
+    const char *arg1 = strtok(NULL, " ");
+    uint32_t kib = arg1 ? (uint32_t)atoi(arg1) : BENCH_SEQ_DEFAULT_KIB;
+    if (!kib || kib > 1024 * 1024)
+    {
+        printf("Tamanho inválido: use de 1 a %d KiB\n", 1024 * 1024);
+        return;
+    }
+
+    // Fora da gravação os buffers de gravação estão livres: 32 KiB contíguos
+    uint8_t *buf = (uint8_t *)log_staging;
+    size_t buf_size = sizeof log_staging;
+    for (size_t i = 0; i < buf_size; i++)
+        buf[i] = (uint8_t)i;
+
+    static bench_row_t rows[BENCH_ROWS];
+    sd_card_t *pSD = sd_get_by_num(0);
+    FATFS *p_fs = sd_get_fs_by_name(pSD->pcName);
+
+    printf("Medindo (%lu KiB sequenciais, %d escritas por tamanho)...\n", (unsigned long)kib, BENCH_APPEND_N);
+    FRESULT fr;
+    size_t nrows = bench_run(p_fs, pSD->pcName, "bench.tmp", buf, buf_size, kib, rows, &fr);
+    if (!p_fs->fs_type) // A montagem a frio falhou
+        pSD->mounted = montado = false;
+    if (FR_OK != fr)
+        printf("Erro durante a medida: %s (%d)\n", FRESULT_str(fr), fr);
+    if (!nrows)
+        return;
+
+    // Mesmas linhas no terminal e no arquivo
+    static char csv[BENCH_ROWS][96];
+    printf("\n%s", BENCH_CSV_HEADER);
+    for (size_t i = 0; i < nrows; i++)
+    {
+        bench_format_row(csv[i], sizeof csv[i], &rows[i], pSD->baud_rate, pSD->sectors);
+        printf("%s", csv[i]);
+    }
+    if (!is_sd_mounted())
+        return;
+    static FIL fil;
+    fr = f_open(&fil, BENCH_CSV, FA_WRITE | FA_OPEN_APPEND);
+    if (FR_OK == fr)
+    {
+        UINT bw;
+        if (!f_size(&fil))
+            f_write(&fil, BENCH_CSV_HEADER, sizeof BENCH_CSV_HEADER - 1, &bw);
+        for (size_t i = 0; i < nrows && FR_OK == fr; i++)
+            fr = f_write(&fil, csv[i], strlen(csv[i]), &bw);
+        FRESULT fr2 = f_close(&fil);
+        if (FR_OK == fr)
+            fr = fr2;
+    }
+    if (FR_OK != fr)
+        printf("Erro ao gravar %s: %s (%d)\n", BENCH_CSV, FRESULT_str(fr), fr);
+    else
+        printf("Resultados acrescentados a %s\n", BENCH_CSV);
+}
+
+// Sem argumento mostra quantos eventos há em cada anel; 'dump' envia o JSON
+// do Chrome Trace, para colar num arquivo e abrir no ui.perfetto.dev
+static void run_trace()
+{
+#if USE_TRACE
+    const char *arg1 = strtok(NULL, " ");
+    if (!arg1)
+        printf("Rastreamento %s: %lu eventos no núcleo 0, %lu no núcleo 1 (até %d por núcleo)\n",
+               trace_is_enabled() ? "ligado" : "desligado", (unsigned long)trace_count(0),
+               (unsigned long)trace_count(1), TRACE_RING_LEN);
+    else if (!strcmp(arg1, "dump"))
+        trace_dump();
+    else if (!strcmp(arg1, "clear"))
+        trace_clear();
+    else if (!strcmp(arg1, "on") || !strcmp(arg1, "off"))
+        trace_enable(!strcmp(arg1, "on"));
+    else
+        printf("Uso: trace [dump|clear|on|off]\n");
+#else
+    printf("Rastreamento não compilado: configure com -DUSE_TRACE=ON\n");
+#endif
+}
+
+// Contadores sempre ativos de toda a pilha, desde o último 'stats' (ou o
+// boot). Zerá-los a cada leitura deixa cada chamada medir um intervalo.
+static void run_stats()
+{
+    sd_card_t *pSD = sd_get_by_num(0);
+    sd_card_stats_t *st = &pSD->stats;
+    spi_t *spi = pSD->spi;
+
+    uint32_t ring_samples = sample_ring_total(&sample_ring), ring_drops = sample_ring_overflows(&sample_ring);
+    uint32_t hwm = sample_ring_high_watermark(&sample_ring);
+    if (logger_stats.high_watermark > hwm)
+        hwm = logger_stats.high_watermark;
+    printf("Gravador: %lu amostras, %lu perdidas, ocupação máxima do anel %lu de %lu, %lu falhas de escrita\n",
+           (unsigned long)(logger_stats.samples + ring_samples - logger_stats.samples_base),
+           (unsigned long)(logger_stats.drops + ring_drops - logger_stats.drops_base), (unsigned long)hwm,
+           (unsigned long)sample_ring_capacity(&sample_ring), (unsigned long)logger_stats.write_errors);
+    printf("FatFs: disk_read %lu chamadas, disk_write %lu chamadas; fila: %lu leituras, %lu escritas\n",
+           (unsigned long)st->disk_reads, (unsigned long)st->disk_writes, (unsigned long)st->async_reads,
+           (unsigned long)st->async_writes);
+    printf("       %llu setores lidos, %llu setores escritos\n", (unsigned long long)st->sectors_read,
+           (unsigned long long)st->sectors_written);
+    printf("SD: escritas %lu CMD24, %lu CMD25, %lu blocos\n", (unsigned long)st->single_block_writes,
+           (unsigned long)st->multi_block_writes, (unsigned long)st->blocks_written);
+    printf("    comandos:");
+    for (size_t i = 0; i < count_of(st->commands); i++)
+        if (st->commands[i])
+            printf(" CMD%u=%lu", (unsigned)i, (unsigned long)st->commands[i]);
+    printf("\n");
+    printf("    %lu erros de CRC, %lu comandos repetidos, %lu transferências repetidas, %lu reduções de clock\n",
+           (unsigned long)st->crc_errors, (unsigned long)st->command_retries, (unsigned long)st->transfer_retries,
+           (unsigned long)pSD->clock_step_downs);
+    printf("    espera ocupada: sd_wait_ready %.1f ms, sd_wait_token %.1f ms\n", st->wait_ready_us / 1e3f,
+           st->wait_token_us / 1e3f);
+    printf("SPI: %lu transferências DMA (%llu bytes), %lu curtas sem DMA (%llu bytes)\n",
+           (unsigned long)spi->dma_transfers, (unsigned long long)spi->dma_bytes,
+           (unsigned long)spi->polled_transfers, (unsigned long long)spi->polled_bytes);
+
+    // Zera tudo; o anel só pode ser zerado com o amostrador parado, então
+    // guarda onde ele está
+    memset(&logger_stats, 0, sizeof logger_stats);
+    logger_stats.samples_base = ring_samples;
+    logger_stats.drops_base = ring_drops;
+    sample_ring_reset_high_watermark(&sample_ring);
+    memset(st, 0, sizeof *st);
+    pSD->clock_step_downs = 0;
+    spi->dma_transfers = spi->polled_transfers = 0;
+    spi->dma_bytes = spi->polled_bytes = 0;
+    if (recording)
+        capture_sd_stats = *st; // O resumo da gravação continua coerente
+}
+
+static void run_sdclock()
+{
+    sd_card_t *pSD = sd_get_by_num(0);
+    if (pSD->m_Status & STA_NOINIT)
+    {
+        printf("Monte o cartão SD para negociar a frequência\n");
+        return;
+    }
+    printf("SCK do SD: %lu Hz (teto %lu Hz), %lu reduções por erro desde a montagem\n",
+           (unsigned long)pSD->baud_rate, (unsigned long)pSD->spi->baud_rate,
+           (unsigned long)pSD->clock_step_downs);
+}
+
+// Confere crc16() (slice-by-N) contra o laço byte a byte original em blocos
+// aleatórios de tamanhos variados e mede os dois em blocos de 512 bytes
+static void run_crcbench()
+{
+    const char *arg1 = strtok(NULL, " ");
+    uint32_t n = arg1 ? (uint32_t)atoi(arg1) : CRC_BENCH_DEFAULT_N;
+    if (!n)
+    {
+        printf("Número de blocos inválido\n");
+        return;
+    }
+    static uint8_t block[512];
+    uint32_t seed = time_us_32() | 1;
+    uint32_t mismatches = 0;
+    for (uint32_t t = 0; t < 500; t++)
+    {
+        for (size_t i = 0; i < sizeof(block); i++)
+        {
+            seed ^= seed << 13; // xorshift32
+            seed ^= seed >> 17;
+            seed ^= seed << 5;
+            block[i] = seed;
+        }
+        int len = t < 32 ? (int)t : (int)(seed % (sizeof(block) + 1));
+        if (crc16((const char *)block, len) != crc16_bytewise((const char *)block, len))
+            mismatches++;
+    }
+    printf("Equivalência com o laço original: %s (500 blocos de 0 a 512 bytes)\n",
+           mismatches ? "FALHOU" : "ok");
+
+    volatile unsigned short sink = 0;
+    uint64_t t0 = time_us_64();
+    for (uint32_t i = 0; i < n; i++)
+        sink ^= crc16_bytewise((const char *)block, sizeof(block));
+    uint64_t t_byte = time_us_64() - t0;
+    t0 = time_us_64();
+    for (uint32_t i = 0; i < n; i++)
+        sink ^= crc16((const char *)block, sizeof(block));
+    uint64_t t_slice = time_us_64() - t0;
+    (void)sink;
+
+    printf("%lu blocos de 512 bytes:\n", (unsigned long)n);
+    printf("  byte a byte    %7.2f us/bloco %7.2f MB/s\n", (float)t_byte / n,
+           t_byte ? n * 512.0f / t_byte : 0);
+    printf("  slice-by-%d     %7.2f us/bloco %7.2f MB/s\n", CRC16_SLICES, (float)t_slice / n,
+           t_slice ? n * 512.0f / t_slice : 0);
+    printf("  sniffer do DMA %s (calcula durante a própria transferência SPI)\n",
+           sd_get_by_num(0)->spi->crc16_sniff ? "ativo" : "inativo");
+}
+
+// Conta as linhas do arquivo duas vezes, com f_gets e com o leitor em
+// blocos, sem imprimir nada: mede só a leitura
+static void run_linebench()
+{
+    char *arg1 = strtok(NULL, " ");
+    if (!arg1)
+    {
+        printf("Uso: linebench <arquivo>\n");
+        return;
+    }
+    static FIL fil;
+    static char rd[LINE_READ_SIZE] __attribute__((aligned(4)));
+    uint32_t lines[2] = {0, 0};
+    uint64_t us[2];
+    for (int method = 0; method < 2; method++)
+    {
+        FRESULT fr = f_open(&fil, arg1, FA_READ);
+        if (FR_OK != fr)
+        {
+            printf("f_open error: %s (%d)\n", FRESULT_str(fr), fr);
+            return;
+        }
+        uint64_t t0 = time_us_64();
+        if (method == 0)
+        {
+            char buf[256];
+            while (f_gets(buf, sizeof buf, &fil))
+            {
+                lines[0]++;
+                capture_keep_alive();
+            }
+        }
+        else
+        {
+            f_lines_t lr;
+            size_t n;
+            f_lines_init(&lr, &fil, rd, sizeof rd);
+            while (f_lines_next(&lr, &n))
+            {
+                lines[1]++;
+                capture_keep_alive();
+            }
+        }
+        us[method] = time_us_64() - t0;
+        f_close(&fil);
+    }
+    FSIZE_t size = 0;
+    FILINFO fno;
+    if (FR_OK == f_stat(arg1, &fno))
+        size = fno.fsize;
+    static const char *names[] = {"f_gets", "leitor em blocos"};
+    for (int m = 0; m < 2; m++)
+        printf("  %-17s %8lu linhas %8.3f s %9.0f linhas/s %7.1f KB/s\n", names[m], (unsigned long)lines[m],
+               us[m] / 1e6f, us[m] ? lines[m] * 1e6f / us[m] : 0, us[m] ? size * 1e3f / 1024 / us[m] : 0);
+}
+
+static void run_prealloc()
+{
+    const char *arg1 = strtok(NULL, " ");
+    if (arg1)
+    {
+        if (recording)
+        {
+            printf("Pare a gravação antes de alterar a pré-alocação\n");
+            return;
+        }
+        int seconds = atoi(arg1);
+        if (seconds < 0 || seconds > PREALLOC_MAX_S)
+        {
+            printf("Duração inválida: use de 0 a %d s\n", PREALLOC_MAX_S);
+            return;
+        }
+        prealloc_seconds = seconds;
+    }
+    if (prealloc_seconds)
+        printf("Pré-alocação: %lu s (%lu KiB a %lu Hz)\n", (unsigned long)prealloc_seconds,
+               (unsigned long)((uint64_t)sample_rate_hz * prealloc_seconds * sizeof(imu_log_record_t) / 1024),
+               (unsigned long)sample_rate_hz);
+    else
+        printf("Pré-alocação desligada\n");
+}
+
+static void run_imubench()
+{
+    if (recording)
+    {
+        printf("Pare a gravação antes de medir o sensor\n");
+        return;
+    }
+    const char *arg1 = strtok(NULL, " ");
+    uint32_t iterations = arg1 ? (uint32_t)atoi(arg1) : IMU_BENCH_DEFAULT_ITER;
+    if (!iterations || iterations & CORE1_CMD_MASK)
+    {
+        printf("Número de iterações inválido\n");
+        return;
+    }
+
+#if MULTICORE_MODE
+    // O I2C0 pertence ao núcleo 1: a medição roda lá
+    multicore_fifo_push_blocking(CORE1_CMD_BENCH | iterations);
+    multicore_fifo_pop_blocking();
+#else
+    imu_bench(iterations);
+#endif
+
+    const char *names[] = {"3 leituras (0x3B, 0x43, 0x41)", "rajada 0x3B..0x48"};
+    float cycles_per_us = clock_get_hz(clk_sys) / 1e6f;
+    printf("Leitura do MPU6050, %lu iterações:\n", (unsigned long)imu_bench_iterations);
+    for (int path = 0; path < 2; path++)
+    {
+        const imu_bench_result_t *r = &imu_bench_results[path];
+        uint32_t avg = r->total / imu_bench_iterations;
+        printf("  %-30s min %7lu  média %7lu  máx %7lu ciclos (média %.1f us)\n",
+               names[path], (unsigned long)r->min, (unsigned long)avg,
+               (unsigned long)r->max, avg / cycles_per_us);
+    }
+}
+
 static void run_help()
 {
     printf("\n***Comandos disponíveis***\n\n");
@@ -841,6 +2378,9 @@ static void run_help()
     printf("Press o botao 'A' para gravar os dados do sensor no SD em .csv e press novamente para parar\n");
     printf("Digite 'g' para formatar o cartão SD\n");
     printf("Digite 'h' para exibir os comandos disponíveis\n");
+    printf("\nComandos do terminal (digite e tecle Enter):\n");
+    for (size_t i = 0; i < count_of(cmds); ++i)
+        printf("  %s\n", cmds[i].help);
     printf("\nEscolha o comando:  ");
 }
 
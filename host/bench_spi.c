@@ -0,0 +1,82 @@
+/* bench_spi.c
+Comandos por segundo de CMD13 (SEND_STATUS) e CMD17 (READ_SINGLE_BLOCK)
+com o driver de verdade sobre o cartão emulado (sd_emu.c), antes e depois
+do caminho curto do spi_transfer(): com dma_threshold 1 toda transferência
+vai por DMA, como antes; com o padrão (SPI_DMA_THRESHOLD) as curtas usam
+as FIFOs do PL022.
+
+O tempo é o do relógio virtual: o barramento a SCK, mais os custos de
+chamada, de disparo do DMA e da interrupção do pico_host_hw.h. Os números
+comparam os dois caminhos, não medem uma placa. Falha se o caminho curto
+não for mais rápido.
+*/
+#include <stdlib.h>
+
+#include "pico/stdlib.h"
+#include "ff.h"
+#include "diskio.h"
+#include "host_test.h"
+#include "hw_config.h"
+#include "sd_emu.h"
+
+#define SECTORS (8 * 1024)
+
+typedef struct {
+    double cmd_s;
+    double dma_per_cmd;
+    double polled_per_cmd;
+} result_t;
+
+static result_t run(const char *label, uint threshold, int cmd, uint32_t n)
+{
+    static uint8_t buf[512];
+    sd_card_t *pSD = sd_get_by_num(0);
+    spi_t *spi = pSD->spi;
+    spi->dma_threshold = threshold;
+    spi->dma_transfers = spi->polled_transfers = 0;
+    uint32_t before = pSD->stats.commands[cmd];
+    uint64_t t0 = host_time_ns();
+    for (uint32_t i = 0; i < n; i++) {
+        if (13 == cmd)
+            CHECK(pSD->sd_test_com(pSD));
+        else
+            CHECK(RES_OK == disk_read(0, buf, i % SECTORS, 1));
+    }
+    uint64_t ns = host_time_ns() - t0;
+    CHECK(pSD->stats.commands[cmd] - before == n);
+    result_t r = {1e9 * n / ns, (double)spi->dma_transfers / n,
+                  (double)spi->polled_transfers / n};
+    printf("%-8s %5u  CMD%-3d %6u %9.0f %8.2f %7.1f %8.1f\n", label, threshold, cmd,
+           sd_emu_model()->card.read_access_us, r.cmd_s, 1e6 / r.cmd_s, r.dma_per_cmd,
+           r.polled_per_cmd);
+    return r;
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t n = argc > 1 ? strtoul(argv[1], NULL, 0) : 2000;
+    CHECK(sd_emu_open_ram(SECTORS));
+    CHECK(0 == (disk_initialize(0) & STA_NOINIT));
+    printf("SCK %u Hz, %lu comandos de cada\n", sd_get_by_num(0)->baud_rate, (unsigned long)n);
+    printf("caminho  limiar  cmd    NAC us     cmd/s   us/cmd DMA/cmd FIFO/cmd\n");
+
+    // O CMD17 também sem o tempo de acesso do cartão, que esconde o resto
+    static const struct {
+        int cmd;
+        bool nac;
+    } runs[] = {{13, true}, {17, true}, {17, false}};
+    uint32_t nac = sd_emu_model()->card.read_access_us;
+    for (size_t i = 0; i < count_of(runs); i++) {
+        sd_emu_model()->card.read_access_us = runs[i].nac ? nac : 0;
+        result_t antes = run("antes", 1, runs[i].cmd, n);
+        result_t depois = run("depois", SPI_DMA_THRESHOLD, runs[i].cmd, n);
+        printf("CMD%d: %.2fx\n", runs[i].cmd, depois.cmd_s / antes.cmd_s);
+        CHECK(depois.cmd_s > antes.cmd_s);
+        CHECK(0 == antes.polled_per_cmd);
+        CHECK(depois.dma_per_cmd < antes.dma_per_cmd);
+    }
+    sd_emu_close();
+    return host_test_result("bench_spi");
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,80 @@
+/* bench_storage.c
+O comando 'bench' do datalogger.c no host: a pilha inteira (FatFs, fila
+assíncrona, sd_card.c, sd_spi.c e spi.c) sobre o cartão emulado
+(sd_emu.c), no relógio virtual, com as mesmas medidas da placa
+(storage_bench.c): vazão sequencial, latência (p50/p99/máximo) de leituras
+e escritas de 512 B em setores ao acaso e de escritas pequenas acrescentadas
+(64 B a 32 KiB), custo do f_sync e tempo de montagem. Acrescenta as linhas
+a um CSV com as mesmas colunas do bench.csv da placa, para comparar modelos
+de cartão e versões do driver.
+
+Uso: bench_storage [<arquivo.csv> [<KiB> [<SCK máximo do cartão, Hz>]]]
+*/
+#include <stdlib.h>
+#include <string.h>
+
+#include "pico/stdlib.h"
+#include "ff.h"
+#include "diskio.h"
+#include "f_util.h"
+#include "host_test.h"
+#include "hw_config.h"
+#include "sd_emu.h"
+#include "storage_bench.h"
+
+#define SECTORS (256ull * 1024 * 1024 / 512)  // 256 MiB
+#define BENCH_SEQ_DEFAULT_KIB 4096
+
+static FATFS fs;
+
+int main(int argc, char **argv)
+{
+    const char *csv_path = argc > 1 ? argv[1] : "bench.csv";
+    uint32_t kib = argc > 2 ? strtoul(argv[2], NULL, 0) : BENCH_SEQ_DEFAULT_KIB;
+    uint32_t max_hz = argc > 3 ? strtoul(argv[3], NULL, 0) : 0;
+    static uint8_t work[FF_MAX_SS];
+    static uint8_t buf[32 * 1024];  // Os buffers de gravação da placa
+    for (size_t i = 0; i < sizeof buf; i++) buf[i] = (uint8_t)i;
+
+    CHECK(sd_emu_open_ram(SECTORS));
+    sd_emu_model()->max_hz = max_hz;
+    MKFS_PARM opt = {FM_ANY, 0, 0, 0, 0};
+    CHECK_FR(f_mkfs("0:", &opt, work, sizeof work));
+    CHECK_FR(f_mount(&fs, "0:", 1));
+
+    static bench_row_t rows[BENCH_ROWS];
+    sd_card_t *pSD = sd_get_by_num(0);
+    pSD->status_check = SD_STATUS_CHECK_ON_SYNC;  // Como no hw_config.c do datalogger
+    FRESULT fr;
+    size_t nrows = bench_run(&fs, "0:", "0:/bench.tmp", buf, sizeof buf, kib, rows, &fr);
+    CHECK_FR(fr);
+    CHECK(count_of(rows) == nrows);
+
+    // Mesmas linhas no terminal e no arquivo, com cabeçalho se ele é novo
+    FILE *f = fopen(csv_path, "a");
+    CHECK(f);
+    if (f && 0 == ftell(f)) fputs(BENCH_CSV_HEADER, f);
+    printf("%s", BENCH_CSV_HEADER);
+    for (size_t i = 0; i < nrows; i++) {
+        char line[96];
+        bench_format_row(line, sizeof line, &rows[i], pSD->baud_rate, pSD->sectors);
+        printf("%s", line);
+        if (f) fputs(line, f);
+    }
+    if (f) fclose(f);
+
+    // Coerência: a escrita sequencial não passa do barramento, e a leitura
+    // também não
+    double bus_mb_s = pSD->baud_rate / 8e6;
+    CHECK(rows[0].mb_s > 0 && rows[0].mb_s < bus_mb_s);
+    CHECK(rows[1].mb_s > 0 && rows[1].mb_s < bus_mb_s);
+    for (size_t i = 2; i < nrows; i++)
+        CHECK(rows[i].p50_us <= rows[i].p99_us && rows[i].p99_us <= rows[i].max_us);
+    // Um setor ao acaso custa mais por byte que a leitura sequencial
+    CHECK(0 == strcmp("rand_read", rows[2].test) && rows[2].mb_s < rows[1].mb_s);
+    f_unmount("0:");
+    sd_emu_close();
+    return host_test_result("bench_storage");
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,39 @@
+/* host_test.h
+Verificações dos testes do host: CHECK imprime a condição que falhou e
+conta; main devolve host_test_result() ao ctest.
+*/
+#pragma once
+
+#include <stdio.h>
+
+static int host_test_failures;
+
+#define CHECK(cond)                                                     \
+    do {                                                                \
+        if (!(cond)) {                                                  \
+            printf("%s:%d: falhou: %s\n", __FILE__, __LINE__, #cond);  \
+            host_test_failures++;                                       \
+        }                                                               \
+    } while (0)
+
+#define CHECK_FR(expr)                                                  \
+    do {                                                                \
+        FRESULT fr_ = (expr);                                           \
+        if (FR_OK != fr_) {                                             \
+            printf("%s:%d: %s: %s (%d)\n", __FILE__, __LINE__, #expr,   \
+                   FRESULT_str(fr_), fr_);                              \
+            host_test_failures++;                                       \
+        }                                                               \
+    } while (0)
+
+static inline int host_test_result(const char *name)
+{
+    if (host_test_failures) {
+        printf("%s: %d falha(s)\n", name, host_test_failures);
+        return 1;
+    }
+    printf("%s: ok\n", name);
+    return 0;
+}
+
+/* [] END OF FILE */
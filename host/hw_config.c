@@ -0,0 +1,44 @@
+/* hw_config.c
+Configuração do cartão para os testes do host: a mesma do hw_config.c da
+placa, um cartão "0:" no spi0. Também dá a hora ao FatFs, no lugar do
+rtc.c: uma data fixa, para que as imagens geradas sejam reprodutíveis.
+*/
+#include <assert.h>
+
+#include "hw_config.h"
+#include "ff.h"
+
+static spi_t spis[] = {
+    {
+        .hw_inst = spi0,
+        .miso_gpio = 16,
+        .mosi_gpio = 19,
+        .sck_gpio = 18,
+        .baud_rate = 25 * 1000 * 1000
+    }};
+
+static sd_card_t sd_cards[] = {
+    {
+        .pcName = "0:",
+        .spi = &spis[0],
+        .ss_gpio = 17,
+        .use_card_detect = false
+    }};
+
+size_t sd_get_num() { return count_of(sd_cards); }
+sd_card_t *sd_get_by_num(size_t num) {
+    assert(num < sd_get_num());
+    return num < sd_get_num() ? &sd_cards[num] : NULL;
+}
+size_t spi_get_num() { return count_of(spis); }
+spi_t *spi_get_by_num(size_t num) {
+    assert(num < spi_get_num());
+    return num < spi_get_num() ? &spis[num] : NULL;
+}
+
+DWORD get_fattime(void) {
+    // 2025-01-01 12:00:00
+    return ((DWORD)(2025 - 1980) << 25) | (1u << 21) | (1u << 16) | (12u << 11);
+}
+
+/* [] END OF FILE */
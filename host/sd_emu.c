@@ -0,0 +1,562 @@
+/* sd_emu.c
+Emulador de cartão SD no modo SPI: ver sd_emu.h.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pico/stdlib.h"
+#include "ff.h"
+#include "diskio.h"
+#include "hw_config.h"
+#include "sd_emu.h"
+
+#define BLOCK 512
+#define QUEUE_LEN 1024
+
+// R1
+#define R1_IDLE 0x01
+#define R1_ILLEGAL 0x04
+#define R1_COM_CRC 0x08
+#define R1_PARAMETER 0x40
+
+// Tokens e respostas de dados (os 3 bits de cima não são definidos: 1)
+#define TOKEN_START 0xFE
+#define TOKEN_START_MULTI 0xFC
+#define TOKEN_STOP_TRAN 0xFD
+#define DATA_ACCEPTED 0xE5
+#define DATA_CRC_ERROR 0xEB
+#define DATA_WRITE_ERROR 0xED
+
+// Segundo byte do R2: bit 2, erro genérico
+#define R2_ERROR 0x04
+
+// O papel de cada byte, para os contadores
+enum { K_RESP, K_DATA, K_OVERHEAD, K_FILL };
+
+enum { W_NONE, W_TOKEN, W_DATA };
+
+static struct {
+    sd_store_t store;
+    sd_emu_model_t model;
+    sd_emu_faults_t faults;
+    sd_emu_stats_t stats;
+    sd_model_state_t card;
+    spi_inst_t *spi;
+
+    bool cs;              // Nível do CS: true = desselecionado
+    uint32_t clocks_high; // Bytes com CS alto antes do CMD0 (>= 74 clocks)
+    bool spi_mode;        // Recebeu CMD0 com CS baixo
+    bool ready;           // ACMD41 terminou
+    uint64_t acmd41_ns;   // Instante do primeiro ACMD41; 0 se não houve
+    bool crc_on;
+    bool app_cmd;         // O último comando foi CMD55
+    uint8_t cmd[6];
+    int cmd_len;
+    uint32_t cmd_count;
+    uint8_t status;       // Segundo byte do R2, lido e zerado pelo CMD13
+    uint64_t busy_until_ns;
+
+    struct {
+        uint8_t v;
+        uint8_t kind;
+    } q[QUEUE_LEN];
+    int q_head, q_len;
+
+    struct {
+        bool active;
+        bool multi;
+        uint64_t sector;
+        uint64_t ready_ns;    // Quando o próximo token pode sair
+        const uint8_t *reg;   // Leitura de registrador (CSD, CID, SD Status)
+        uint32_t reg_len;
+        uint32_t count;       // Blocos lidos desde a abertura
+    } rd;
+
+    struct {
+        int state;
+        bool multi;
+        bool first;
+        uint64_t sector;
+        uint8_t buf[BLOCK + 2];
+        uint32_t n;
+        uint32_t count;       // Blocos recebidos desde a abertura
+    } wr;
+
+    uint8_t csd[16];
+    uint8_t cid[16];
+    uint8_t sd_status[64];
+} emu = {.store = {.fd = -1}, .cs = true};
+
+sd_emu_model_t *sd_emu_model(void) { return &emu.model; }
+sd_emu_faults_t *sd_emu_faults(void) { return &emu.faults; }
+sd_emu_stats_t *sd_emu_stats(void) { return &emu.stats; }
+uint8_t *sd_emu_data(void) { return emu.store.data; }
+
+static uint8_t crc7(const uint8_t *data, size_t len)
+{
+    uint8_t crc = 0;
+    for (size_t i = 0; i < len; i++) {
+        uint8_t d = data[i];
+        for (int b = 0; b < 8; b++) {
+            bool top = (crc >> 6) ^ (d >> 7);
+            crc = (crc << 1) & 0x7F;
+            if (top) crc ^= 0x09;
+            d <<= 1;
+        }
+    }
+    return crc;
+}
+
+static bool fault_due(uint32_t n, uint32_t at, uint32_t every)
+{
+    return n == at || (every && 0 == n % every);
+}
+
+static bool too_fast(void)
+{
+    return emu.model.max_hz && spi_get_baudrate(emu.spi) > emu.model.max_hz;
+}
+
+// ---------------------------------------------------------------------------
+// Fila de saída
+// ---------------------------------------------------------------------------
+
+static void push(uint8_t v, int kind)
+{
+    if (QUEUE_LEN == emu.q_len) {
+        fprintf(stderr, "sd_emu: fila de saída cheia\n");
+        abort();
+    }
+    int i = (emu.q_head + emu.q_len++) % QUEUE_LEN;
+    emu.q[i].v = v;
+    emu.q[i].kind = kind;
+}
+
+static void push_block(const uint8_t *data, uint32_t len, bool bad_crc)
+{
+    uint16_t crc = host_crc16_ccitt(0, data, len);
+    if (bad_crc) crc ^= 0x0100;
+    push(TOKEN_START, K_OVERHEAD);
+    for (uint32_t i = 0; i < len; i++) push(data[i], K_DATA);
+    if (too_fast()) {  // Um bit trocado no caminho
+        emu.q[(emu.q_head + emu.q_len - len / 2) % QUEUE_LEN].v ^= 0x10;
+        bad_crc = true;
+    }
+    if (bad_crc) emu.stats.read_crc_faults++;
+    push(crc >> 8, K_OVERHEAD);
+    push(crc & 0xFF, K_OVERHEAD);
+}
+
+static void respond(uint8_t r1)
+{
+    for (uint32_t i = 0; i < emu.model.ncr_bytes; i++) push(0xFF, K_RESP);
+    push(r1, K_RESP);
+}
+
+// ---------------------------------------------------------------------------
+// Registradores
+// ---------------------------------------------------------------------------
+
+static void make_registers(void)
+{
+    // CSD versão 2.0 de um SDHC: TAAC 1 ms, 25 MHz, blocos de 512 bytes
+    static const uint8_t csd[16] = {0x40, 0x0E, 0x00, 0x32, 0x5B, 0x59, 0x00, 0x00,
+                                    0x00, 0x00, 0x7F, 0x80, 0x0A, 0x40, 0x00, 0x01};
+    memcpy(emu.csd, csd, sizeof csd);
+    uint32_t c_size = (uint32_t)(emu.store.sectors / 1024) - 1;  // CSD[69:48]
+    emu.csd[7] = (c_size >> 16) & 0x3F;
+    emu.csd[8] = c_size >> 8;
+    emu.csd[9] = c_size;
+    emu.csd[15] = crc7(emu.csd, 15) << 1 | 1;
+
+    static const uint8_t cid[16] = {0x03, 'S', 'D', 'H', 'O', 'S', 'T', 0x10,
+                                    0x00, 0x00, 0x00, 0x01, 0x01, 0x9A, 0x00, 0x01};
+    memcpy(emu.cid, cid, sizeof cid);
+    emu.cid[15] = crc7(emu.cid, 15) << 1 | 1;
+
+    // SD Status: AU_SIZE em SD_STATUS[431:428], o nibble alto do byte 10
+    static const uint32_t au_kib[16] = {
+        0,    16,   32,   64,    128,   256,   512,   1024,
+        2048, 4096, 8192, 12288, 16384, 24576, 32768, 65536};
+    uint8_t au = 0;
+    for (uint8_t i = 1; i < 16; i++) {
+        if (au_kib[i] * 2 <= emu.model.card.au_sectors) au = i;
+    }
+    memset(emu.sd_status, 0, sizeof emu.sd_status);
+    emu.sd_status[8] = 0x04;  // SPEED_CLASS 10
+    emu.sd_status[10] = au << 4;
+}
+
+// ---------------------------------------------------------------------------
+// Comandos
+// ---------------------------------------------------------------------------
+
+static void reset_card(void)
+{
+    emu.ready = false;
+    emu.acmd41_ns = 0;
+    emu.crc_on = false;
+    emu.app_cmd = false;
+    emu.status = 0;
+    emu.rd.active = false;
+    emu.wr.state = W_NONE;
+}
+
+static void start_read(uint64_t sector, bool multi, uint64_t t_ns)
+{
+    emu.rd.active = true;
+    emu.rd.multi = multi;
+    emu.rd.sector = sector;
+    emu.rd.reg = NULL;
+    emu.rd.ready_ns = t_ns + 1000ull * emu.model.card.read_access_us;
+}
+
+static void start_reg_read(const uint8_t *reg, uint32_t len, uint64_t t_ns)
+{
+    emu.rd.active = true;
+    emu.rd.multi = false;
+    emu.rd.reg = reg;
+    emu.rd.reg_len = len;
+    emu.rd.ready_ns = t_ns;
+}
+
+static void command(uint64_t t_ns)
+{
+    uint8_t idx = emu.cmd[0] & 0x3F;
+    uint32_t arg = (uint32_t)emu.cmd[1] << 24 | emu.cmd[2] << 16 | emu.cmd[3] << 8 | emu.cmd[4];
+    bool crc_ok = (emu.cmd[5] | 1) == (crc7(emu.cmd, 5) << 1 | 1) && (emu.cmd[5] & 1);
+
+    if (fault_due(++emu.cmd_count, emu.faults.drop_cmd_at, 0)) {
+        emu.stats.dropped_commands++;
+        return;
+    }
+    if (!emu.spi_mode) {
+        // Só o CMD0 com CS baixo, depois dos 74 clocks, entra no modo SPI
+        if (0 != idx || !crc_ok || emu.clocks_high < 10) return;
+        emu.spi_mode = true;
+    }
+    // Identificação a no máximo 400 kHz
+    if (!emu.ready && spi_get_baudrate(emu.spi) > 400000) return;
+
+    bool app = emu.app_cmd;
+    emu.app_cmd = false;
+    uint8_t r1 = emu.ready ? 0 : R1_IDLE;
+    if ((emu.crc_on || 0 == idx || 8 == idx) && !crc_ok) {
+        emu.stats.crc7_errors++;
+        respond(r1 | R1_COM_CRC);
+        return;
+    }
+    if (app) {
+        emu.stats.acmds[idx]++;
+        switch (idx) {
+            case 13:  // ACMD13 SD_STATUS: R2 e o bloco de 64 bytes
+                if (!emu.ready) break;
+                respond(r1);
+                push(0, K_RESP);
+                start_reg_read(emu.sd_status, sizeof emu.sd_status, t_ns);
+                return;
+            case 23:  // ACMD23 SET_WR_BLK_ERASE_COUNT: só uma sugestão
+                if (!emu.ready) break;
+                respond(r1);
+                return;
+            case 41:  // ACMD41 SD_SEND_OP_COND
+                if (!emu.acmd41_ns) emu.acmd41_ns = t_ns;
+                // Um SDHC não sai do idle sem HCS
+                if ((arg & (1u << 30)) &&
+                    t_ns - emu.acmd41_ns >= 1000000ull * emu.model.init_ms)
+                    emu.ready = true;
+                respond(emu.ready ? 0 : R1_IDLE);
+                return;
+        }
+        emu.stats.acmds[idx]--;
+        emu.stats.illegal_commands++;
+        respond(r1 | R1_ILLEGAL);
+        return;
+    }
+    emu.stats.commands[idx]++;
+    switch (idx) {
+        case 0:  // GO_IDLE_STATE
+            reset_card();
+            respond(R1_IDLE);
+            return;
+        case 8:  // SEND_IF_COND: R7 ecoa a tensão e o padrão
+            respond(r1);
+            push(0x00, K_RESP);
+            push(0x00, K_RESP);
+            push((arg >> 8) & 0x0F, K_RESP);
+            push(arg & 0xFF, K_RESP);
+            return;
+        case 9:  // SEND_CSD
+        case 10: // SEND_CID
+            respond(r1);
+            start_reg_read(9 == idx ? emu.csd : emu.cid, 16, t_ns);
+            return;
+        case 12: {  // STOP_TRANSMISSION: um byte de enchimento, R1b
+            uint8_t stuff = emu.q_len ? emu.q[emu.q_head].v : 0xFF;
+            emu.q_len = 0;
+            emu.rd.active = false;
+            push(stuff, K_RESP);
+            push(r1, K_RESP);
+            emu.busy_until_ns = t_ns + 1000ull * emu.model.cmd12_busy_us;
+            return;
+        }
+        case 13:  // SEND_STATUS: R2
+            respond(r1);
+            push(emu.status, K_RESP);
+            emu.status = 0;
+            return;
+        case 16:  // SET_BLOCKLEN: num SDHC, só 512
+            respond(r1 | (BLOCK == arg ? 0 : R1_PARAMETER));
+            return;
+        case 17:  // READ_SINGLE_BLOCK
+        case 18:  // READ_MULTIPLE_BLOCK
+            if (!emu.ready) break;
+            if (arg >= emu.store.sectors) {
+                respond(R1_PARAMETER);
+                return;
+            }
+            respond(0);
+            start_read(arg, 18 == idx, t_ns);
+            return;
+        case 24:  // WRITE_BLOCK
+        case 25:  // WRITE_MULTIPLE_BLOCK
+            if (!emu.ready) break;
+            if (arg >= emu.store.sectors) {
+                respond(R1_PARAMETER);
+                return;
+            }
+            respond(0);
+            emu.wr.state = W_TOKEN;
+            emu.wr.multi = 25 == idx;
+            emu.wr.first = true;
+            emu.wr.sector = arg;
+            return;
+        case 55:  // APP_CMD
+            emu.app_cmd = true;
+            respond(r1);
+            return;
+        case 58: {  // READ_OCR: R3, com CCS e "ligado" depois do ACMD41
+            uint32_t ocr = 0x00FF8000 | (emu.ready ? 0xC0000000 : 0);
+            respond(r1);
+            for (int i = 24; i >= 0; i -= 8) push(ocr >> i, K_RESP);
+            return;
+        }
+        case 59:  // CRC_ON_OFF
+            emu.crc_on = arg & 1;
+            respond(r1);
+            return;
+    }
+    emu.stats.commands[idx]--;
+    emu.stats.illegal_commands++;
+    respond(r1 | R1_ILLEGAL);
+}
+
+// Bloco de escrita completo (dados e CRC): resposta de dados e ocupado
+static void write_block(uint64_t t_ns)
+{
+    sd_emu_stats_t *st = &emu.stats;
+    uint16_t crc = emu.wr.buf[BLOCK] << 8 | emu.wr.buf[BLOCK + 1];
+    if (too_fast()) emu.wr.buf[BLOCK / 2] ^= 0x10;  // Um bit trocado no caminho
+    emu.wr.count++;
+    uint8_t resp;
+    if ((emu.crc_on || too_fast()) && crc != host_crc16_ccitt(0, emu.wr.buf, BLOCK)) {
+        resp = DATA_CRC_ERROR;
+        st->write_crc_errors++;
+    } else if (emu.wr.sector >= emu.store.sectors ||
+               fault_due(emu.wr.count, emu.faults.fail_write_at,
+                         emu.faults.fail_write_every)) {
+        resp = DATA_WRITE_ERROR;
+        emu.status |= R2_ERROR;
+        st->write_errors++;
+    } else {
+        memcpy(emu.store.data + emu.wr.sector * BLOCK, emu.wr.buf, BLOCK);
+        st->blocks_written++;
+        uint32_t busy = sd_model_block_busy_us(&emu.model.card, &emu.card,
+                                               emu.wr.sector, emu.wr.first);
+        st->busy_us = emu.card.busy_us;
+        emu.busy_until_ns = t_ns + 1000ull * busy;
+        emu.wr.sector++;
+        emu.wr.first = false;
+        resp = DATA_ACCEPTED;
+    }
+    push(resp, K_OVERHEAD);
+    // Um CMD25 espera o próximo token mesmo depois de um erro: o host
+    // termina com Stop Tran
+    emu.wr.state = emu.wr.multi ? W_TOKEN : W_NONE;
+}
+
+// ---------------------------------------------------------------------------
+// Barramento
+// ---------------------------------------------------------------------------
+
+// Próximo byte de DO e o seu papel, ou -1 se não é de nenhum
+static uint8_t output(uint64_t t_ns, int *kind, uint64_t **counter)
+{
+    sd_emu_stats_t *st = &emu.stats;
+    *counter = NULL;
+    if (!emu.q_len && emu.rd.active && t_ns >= emu.rd.ready_ns) {
+        if (emu.rd.reg) {
+            push_block(emu.rd.reg, emu.rd.reg_len, false);
+            emu.rd.active = false;
+        } else if (emu.rd.sector >= emu.store.sectors) {
+            push(0x08, K_OVERHEAD);  // Token de erro: fora do cartão
+            emu.rd.active = false;
+        } else {
+            bool bad = fault_due(++emu.rd.count, emu.faults.fail_read_at,
+                                 emu.faults.fail_read_every);
+            push_block(emu.store.data + emu.rd.sector * BLOCK, BLOCK, bad);
+            st->blocks_read++;
+            emu.rd.sector++;
+            if (emu.rd.multi) {
+                // O próximo fica pronto NAC depois do fim deste
+                emu.rd.ready_ns = t_ns + host_spi_bytes_ns(emu.spi, 1 + BLOCK + 2) +
+                                  1000ull * emu.model.card.read_access_us;
+            } else {
+                emu.rd.active = false;
+            }
+        }
+    }
+    if (emu.q_len) {
+        uint8_t v = emu.q[emu.q_head].v;
+        *kind = emu.q[emu.q_head].kind;
+        emu.q_head = (emu.q_head + 1) % QUEUE_LEN;
+        emu.q_len--;
+        return v;
+    }
+    *kind = -1;
+    if (t_ns < emu.busy_until_ns) {
+        *counter = &st->busy_bytes;
+        return 0x00;
+    }
+    *counter = emu.rd.active ? &st->wait_bytes : &st->idle_bytes;
+    return 0xFF;
+}
+
+static uint8_t exchange(void *ctx, uint8_t mosi, uint64_t t_ns)
+{
+    (void)ctx;
+    sd_emu_stats_t *st = &emu.stats;
+    if (!emu.store.data) return 0xFF;
+    if (emu.cs) {
+        st->cs_high_bytes++;
+        if (!emu.spi_mode) emu.clocks_high++;
+        return 0xFF;
+    }
+    st->wire_bytes++;
+
+    // O que sai neste byte já estava decidido antes do que entra nele
+    int kind;
+    uint64_t *counter;
+    uint8_t miso = output(t_ns, &kind, &counter);
+
+    int in_kind = -1;
+    if (W_DATA == emu.wr.state) {
+        emu.wr.buf[emu.wr.n++] = mosi;
+        in_kind = emu.wr.n <= BLOCK ? K_DATA : K_OVERHEAD;
+        if (BLOCK + 2 == emu.wr.n) write_block(t_ns);
+    } else if (emu.cmd_len || (0x40 == (mosi & 0xC0) && t_ns >= emu.busy_until_ns)) {
+        // Com o cartão ocupado, DI é ignorado
+        emu.cmd[emu.cmd_len++] = mosi;
+        st->cmd_bytes++;
+        if (6 == emu.cmd_len) {
+            emu.cmd_len = 0;
+            if (W_TOKEN == emu.wr.state) emu.wr.state = W_NONE;
+            command(t_ns);
+        }
+        return miso;
+    } else if (W_TOKEN == emu.wr.state && t_ns >= emu.busy_until_ns) {
+        if (TOKEN_STOP_TRAN == mosi && emu.wr.multi) {
+            // Um byte (Nbr) e então o ocupado do fim da escrita
+            push(0xFF, K_FILL);
+            emu.card.busy_us += emu.model.card.stop_busy_us;
+            st->busy_us = emu.card.busy_us;
+            emu.busy_until_ns = t_ns + 1000ull * emu.model.card.stop_busy_us;
+            emu.wr.state = W_NONE;
+            in_kind = K_OVERHEAD;
+        } else if ((emu.wr.multi ? TOKEN_START_MULTI : TOKEN_START) == mosi) {
+            emu.wr.state = W_DATA;
+            emu.wr.n = 0;
+            in_kind = K_OVERHEAD;
+        }
+    }
+
+    if (K_DATA == in_kind || K_DATA == kind) {
+        st->data_bytes++;
+    } else if (K_OVERHEAD == in_kind || K_OVERHEAD == kind) {
+        st->overhead_bytes++;
+    } else if (K_RESP == kind) {
+        st->resp_bytes++;
+    } else if (K_FILL == kind) {
+        st->idle_bytes++;
+    } else {
+        (*counter)++;
+    }
+    return miso;
+}
+
+static void cs_changed(bool value, void *ctx)
+{
+    (void)ctx;
+    emu.cs = value;
+    if (value) {
+        // DO solta: a resposta pendente e um comando pela metade se perdem
+        emu.q_len = 0;
+        emu.cmd_len = 0;
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Abertura
+// ---------------------------------------------------------------------------
+
+static bool attach(void)
+{
+    if (emu.store.sectors < 1024) {
+        sd_store_close(&emu.store);
+        return false;
+    }
+    emu.model.card = sd_model_default;
+    emu.model.ncr_bytes = 1;
+    emu.model.init_ms = 20;
+    emu.model.cmd12_busy_us = 10;
+    emu.model.max_hz = 0;
+    memset(&emu.faults, 0, sizeof emu.faults);
+    memset(&emu.stats, 0, sizeof emu.stats);
+    sd_model_reset(&emu.card);
+    emu.clocks_high = 0;
+    emu.spi_mode = false;
+    emu.cmd_len = 0;
+    emu.cmd_count = 0;
+    emu.q_len = 0;
+    emu.busy_until_ns = 0;
+    emu.rd.count = 0;
+    emu.wr.count = 0;
+    reset_card();
+    make_registers();
+
+    sd_card_t *pSD = sd_get_by_num(0);
+    emu.spi = pSD->spi->hw_inst;
+    emu.cs = gpio_get(pSD->ss_gpio);
+    host_spi_attach(emu.spi, exchange, NULL);
+    host_gpio_set_hook(pSD->ss_gpio, cs_changed, NULL);
+    // O cartão foi trocado: a próxima montagem inicializa de novo
+    pSD->m_Status |= STA_NOINIT;
+    return true;
+}
+
+bool sd_emu_open_ram(uint64_t sectors)
+{
+    sd_emu_close();
+    return sd_store_open_ram(&emu.store, sectors) && attach();
+}
+
+bool sd_emu_open_file(const char *path, uint64_t sectors)
+{
+    sd_emu_close();
+    return sd_store_open_file(&emu.store, path, sectors) && attach();
+}
+
+void sd_emu_close(void) { sd_store_close(&emu.store); }
+
+/* [] END OF FILE */
@@ -0,0 +1,87 @@
+/* sd_emu.h
+Emulador de cartão SD no modo SPI, ligado ao SPI e ao CS do cartão "0:" do
+hw_config.c do host. O sd_card.c, o sd_spi.c e o spi.c de verdade rodam por
+cima dele sem mudanças, pelo modelo de SPI/DMA do pico_host_hw.h.
+
+O cartão é uma máquina de estados que vê um byte de cada vez: monta os
+pacotes de comando, confere o CRC7 (sempre no CMD0 e no CMD8, e em todos
+depois do CMD59), responde R1/R2/R3/R7 depois de NCR bytes, manda os blocos
+de leitura com token e CRC16 depois do tempo de acesso (NAC), recebe os
+blocos de escrita, devolve a resposta de dados e segura DO em 0 enquanto
+grava. Comandos: CMD0, 8, 9, 10, 12, 13, 16, 17, 18, 24, 25, 55, 58, 59 e
+ACMD13, 23 e 41; os outros são ilegais. É um SDHC: endereços em blocos.
+
+Os tempos de ocupado vêm do sd_model_t. Os contadores medem o que passa no
+barramento, byte a byte, e quantos comandos de cada tipo chegaram.
+*/
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "sd_model.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    sd_model_t card;
+    uint32_t ncr_bytes;     // Bytes 0xFF antes de cada R1 (1 a 8)
+    uint32_t init_ms;       // O ACMD41 responde "ocupado" por este tempo
+    uint32_t cmd12_busy_us; // Ocupado (R1b) depois do CMD12
+    uint32_t max_hz;        // Acima deste SCK os blocos chegam corrompidos
+                            // nos dois sentidos; 0 não limita
+} sd_emu_model_t;
+
+/* Falhas injetadas, contadas em blocos de dados (leituras e escritas) ou em
+comandos, desde a abertura. */
+typedef struct {
+    uint32_t fail_read_at;      // O N-ésimo bloco lido vai com o CRC errado
+    uint32_t fail_read_every;
+    uint32_t fail_write_at;     // O N-ésimo bloco escrito é recusado com erro de
+    uint32_t fail_write_every;  // escrita, que o CMD13 seguinte também relata
+    uint32_t drop_cmd_at;       // O N-ésimo comando fica sem resposta
+} sd_emu_faults_t;
+
+typedef struct {
+    uint32_t commands[64];      // Comandos aceitos (CRC bom), por índice
+    uint32_t acmds[64];         // Idem, depois de um CMD55
+    uint32_t crc7_errors;       // Comandos recusados com COM_CRC_ERROR
+    uint32_t illegal_commands;
+    uint32_t dropped_commands;  // Injetados
+    // Bytes no barramento com CS baixo, pelo papel de cada um
+    uint64_t wire_bytes;        // Todos
+    uint64_t cmd_bytes;         // Pacotes de comando
+    uint64_t resp_bytes;        // NCR, respostas e o byte de enchimento do CMD12
+    uint64_t data_bytes;        // Conteúdo dos blocos e dos registradores
+    uint64_t overhead_bytes;    // Tokens, CRC16, respostas de dados, Stop Tran
+    uint64_t busy_bytes;        // DO em 0: o cartão gravando
+    uint64_t wait_bytes;        // 0xFF esperando um bloco de leitura (NAC)
+    uint64_t idle_bytes;        // O resto: seleção, enchimento, prontidão
+    uint64_t cs_high_bytes;     // Com o cartão desselecionado
+    uint64_t blocks_read;
+    uint64_t blocks_written;
+    uint32_t read_crc_faults;   // Blocos mandados com CRC errado (injetado ou SCK alto)
+    uint32_t write_crc_errors;  // Blocos recusados por CRC
+    uint32_t write_errors;      // Blocos recusados por falha injetada
+    uint64_t busy_us;           // Tempo de ocupado gravando
+} sd_emu_stats_t;
+
+/* Como no sd_image.h: o cartão aparece como recém-ligado, e a próxima
+montagem o inicializa. A imagem tem de ter um múltiplo de 1024 setores
+(o C_SIZE do CSD). */
+bool sd_emu_open_ram(uint64_t sectors);
+bool sd_emu_open_file(const char *path, uint64_t sectors);
+void sd_emu_close(void);  // O cartão sai do soquete
+
+sd_emu_model_t *sd_emu_model(void);
+sd_emu_faults_t *sd_emu_faults(void);
+sd_emu_stats_t *sd_emu_stats(void);
+uint8_t *sd_emu_data(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+/* [] END OF FILE */
@@ -0,0 +1,320 @@
+/* sd_image.c
+Cartão SD simulado sobre uma imagem na RAM ou num arquivo: ver sd_image.h.
+*/
+#include <stdlib.h>
+#include <string.h>
+
+#include "pico/stdlib.h"
+#include "ff.h"
+#include "diskio.h"
+#include "hw_config.h"
+#include "sd_card.h"
+#include "sd_image.h"
+
+#define BLOCK 512
+
+static struct {
+    sd_store_t store;
+    sd_image_model_t model;
+    sd_image_faults_t faults;
+    sd_image_stats_t stats;
+    sd_model_state_t card;
+    uint64_t busy_until_ns;
+} img = {.store = {.fd = -1}};
+
+// Operação assíncrona em andamento: termina em end_ns
+static struct {
+    bool active;
+    bool read;
+    uint8_t *buffer;
+    uint64_t sector;
+    uint32_t count;
+    int rc;
+    uint64_t end_ns;
+} op;
+
+sd_image_model_t *sd_image_model(void) { return &img.model; }
+sd_image_faults_t *sd_image_faults(void) { return &img.faults; }
+sd_image_stats_t *sd_image_stats(void) { return &img.stats; }
+uint8_t *sd_image_data(void) { return img.store.data; }
+
+static void reset_state(void)
+{
+    img.model.spi_hz = 20833333;  // O divisor do RP2040 para 25 MHz
+    img.model.cmd_us = 20;
+    img.model.card = sd_model_default;
+    memset(&img.faults, 0, sizeof img.faults);
+    memset(&img.stats, 0, sizeof img.stats);
+    sd_model_reset(&img.card);
+    img.busy_until_ns = 0;
+    op.active = false;
+    // O cartão foi trocado: a próxima montagem inicializa de novo
+    for (size_t i = 0; i < sd_get_num(); ++i) {
+        sd_get_by_num(i)->m_Status |= STA_NOINIT;
+    }
+}
+
+void sd_image_close(void) { sd_store_close(&img.store); }
+
+bool sd_image_open_ram(uint64_t sectors)
+{
+    sd_image_close();
+    if (!sd_store_open_ram(&img.store, sectors)) return false;
+    reset_state();
+    return true;
+}
+
+bool sd_image_open_file(const char *path, uint64_t sectors)
+{
+    sd_image_close();
+    if (!sd_store_open_file(&img.store, path, sectors)) return false;
+    reset_state();
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// Modelo de tempo
+// ---------------------------------------------------------------------------
+
+static uint64_t wire_ns(uint32_t bytes)
+{
+    return (uint64_t)bytes * 8 * 1000000000ull / img.model.spi_hz;
+}
+
+// Início de um comando: espera o fim do ocupado anterior
+static uint64_t begin_cmd(void)
+{
+    uint64_t t = host_time_ns();
+    if (img.busy_until_ns > t) {
+        img.stats.wait_busy_us += (img.busy_until_ns - t) / 1000;
+        t = img.busy_until_ns;
+    }
+    return t + img.model.cmd_us * 1000ull;
+}
+
+// Fim de uma escrita começada agora. Como no driver, cada bloco de um CMD25
+// espera o ocupado do anterior e o Stop Tran espera o último; o ocupado de
+// um CMD24 fica para o próximo comando.
+static uint64_t write_end_ns(uint64_t sector, uint32_t count)
+{
+    uint64_t t = begin_cmd();
+    for (uint32_t i = 0; i < count; i++) {
+        t += wire_ns(1 + BLOCK + 2 + 1);  // Token, dados, CRC, resposta
+        uint64_t busy = 1000ull * sd_model_block_busy_us(&img.model.card, &img.card,
+                                                        sector + i, 0 == i);
+        if (1 == count) {
+            img.busy_until_ns = t + busy;
+        } else {
+            t += busy;
+        }
+    }
+    if (count > 1) {
+        t += wire_ns(2);
+        img.card.busy_us += img.model.card.stop_busy_us;
+        t += img.model.card.stop_busy_us * 1000ull;
+    }
+    img.stats.busy_us = img.card.busy_us;
+    return t;
+}
+
+static uint64_t read_end_ns(uint32_t count)
+{
+    uint64_t t = begin_cmd();
+    for (uint32_t i = 0; i < count; i++) {
+        t += img.model.card.read_access_us * 1000ull + wire_ns(1 + BLOCK + 2);
+    }
+    if (count > 1) t += img.model.cmd_us * 1000ull;  // CMD12
+    return t;
+}
+
+static bool fault_due(uint32_t n, uint32_t at, uint32_t every)
+{
+    return n == at || (every && 0 == n % every);
+}
+
+// ---------------------------------------------------------------------------
+// API do sd_card.h
+// ---------------------------------------------------------------------------
+
+static int check_request(sd_card_t *pSD, uint64_t sector, uint32_t count)
+{
+    if (!img.store.data) return SD_BLOCK_DEVICE_ERROR_NO_DEVICE;
+    if (pSD->m_Status & STA_NOINIT) return SD_BLOCK_DEVICE_ERROR_NO_INIT;
+    if (!count || sector + count > img.store.sectors) return SD_BLOCK_DEVICE_ERROR_PARAMETER;
+    return SD_BLOCK_DEVICE_ERROR_NONE;
+}
+
+// Começa a transação: calcula o fim e o resultado; os dados só são copiados
+// em finish_op(), como o DMA de verdade
+static int start_op(sd_card_t *pSD, bool read, uint8_t *buffer,
+                    uint64_t sector, uint32_t count)
+{
+    int rc = check_request(pSD, sector, count);
+    if (SD_BLOCK_DEVICE_ERROR_NONE != rc) return rc;
+    sd_card_stats_t *st = &pSD->stats;
+    sd_image_faults_t *f = &img.faults;
+    op.read = read;
+    op.buffer = buffer;
+    op.sector = sector;
+    op.count = count;
+    op.rc = SD_BLOCK_DEVICE_ERROR_NONE;
+    if (read) {
+        st->commands[count > 1 ? 18 : 17]++;
+        if (count > 1) st->commands[12]++;
+        img.stats.reads++;
+        if (fault_due(img.stats.reads, f->fail_read_at, f->fail_read_every)) {
+            op.rc = f->read_error ? f->read_error : SD_BLOCK_DEVICE_ERROR_CRC;
+            img.stats.read_errors++;
+        }
+        op.end_ns = read_end_ns(count);
+    } else {
+        if (count > 1) {
+            st->commands[55]++;
+            st->commands[23]++;  // ACMD23 antes do CMD25
+            st->commands[25]++;
+            st->multi_block_writes++;
+        } else {
+            st->commands[24]++;
+            st->single_block_writes++;
+        }
+        st->blocks_written += count;
+        img.stats.writes++;
+        if (fault_due(img.stats.writes, f->fail_write_at, f->fail_write_every)) {
+            op.rc = f->write_error ? f->write_error : SD_BLOCK_DEVICE_ERROR_WRITE;
+            img.stats.write_errors++;
+        }
+        op.end_ns = write_end_ns(sector, count);
+    }
+    op.active = true;
+    return SD_BLOCK_DEVICE_ERROR_NONE;
+}
+
+static int finish_op(void)
+{
+    op.active = false;
+    if (SD_BLOCK_DEVICE_ERROR_NONE != op.rc) return op.rc;
+    uint8_t *card = img.store.data + op.sector * BLOCK;
+    if (op.read) {
+        memcpy(op.buffer, card, (size_t)op.count * BLOCK);
+        img.stats.blocks_read += op.count;
+    } else {
+        memcpy(card, op.buffer, (size_t)op.count * BLOCK);
+        img.stats.blocks_written += op.count;
+    }
+    return SD_BLOCK_DEVICE_ERROR_NONE;
+}
+
+static int poll_op(void)
+{
+    if (!op.active) return SD_BLOCK_DEVICE_ERROR_PARAMETER;
+    if (host_time_ns() < op.end_ns) return SD_BLOCK_DEVICE_ERROR_WOULD_BLOCK;
+    return finish_op();
+}
+
+static int run_op(sd_card_t *pSD, bool read, uint8_t *buffer,
+                  uint64_t sector, uint32_t count)
+{
+    int rc = start_op(pSD, read, buffer, sector, count);
+    if (SD_BLOCK_DEVICE_ERROR_NONE != rc) return rc;
+    uint64_t now = host_time_ns();
+    if (op.end_ns > now) host_advance_ns(op.end_ns - now);
+    return finish_op();
+}
+
+int sd_write_blocks_start(sd_card_t *pSD, const uint8_t *buffer,
+                          uint64_t ulSectorNumber, uint32_t blockCnt)
+{
+    return start_op(pSD, false, (uint8_t *)buffer, ulSectorNumber, blockCnt);
+}
+
+int sd_write_blocks_poll(sd_card_t *pSD)
+{
+    (void)pSD;
+    return poll_op();
+}
+
+int sd_read_blocks_start(sd_card_t *pSD, uint8_t *buffer,
+                         uint64_t ulSectorNumber, uint32_t ulSectorCount)
+{
+    return start_op(pSD, true, buffer, ulSectorNumber, ulSectorCount);
+}
+
+int sd_read_blocks_poll(sd_card_t *pSD)
+{
+    (void)pSD;
+    return poll_op();
+}
+
+static int image_write_blocks(sd_card_t *pSD, const uint8_t *buffer,
+                              uint64_t ulSectorNumber, uint32_t blockCnt)
+{
+    return run_op(pSD, false, (uint8_t *)buffer, ulSectorNumber, blockCnt);
+}
+
+static int image_read_blocks(sd_card_t *pSD, uint8_t *buffer,
+                             uint64_t ulSectorNumber, uint32_t ulSectorCount)
+{
+    return run_op(pSD, true, buffer, ulSectorNumber, ulSectorCount);
+}
+
+int sd_sync(sd_card_t *pSD)
+{
+    if (!img.store.data) return SD_BLOCK_DEVICE_ERROR_NO_DEVICE;
+    // O CMD13 adiado pela política de status: espera o ocupado da última
+    // escrita, como o sd_wait_ready() antes de qualquer comando
+    pSD->stats.commands[13]++;
+    uint64_t t = begin_cmd() + wire_ns(1);
+    host_advance_ns(t - host_time_ns());
+    return SD_BLOCK_DEVICE_ERROR_NONE;
+}
+
+bool sd_card_detect(sd_card_t *pSD)
+{
+    if (img.store.data) {
+        pSD->m_Status &= ~STA_NODISK;
+        return true;
+    }
+    pSD->m_Status |= STA_NODISK | STA_NOINIT;
+    return false;
+}
+
+uint64_t sd_sectors(sd_card_t *pSD)
+{
+    (void)pSD;
+    return img.store.sectors;
+}
+
+uint32_t sd_allocation_unit(sd_card_t *pSD)
+{
+    if (pSD->m_Status & (STA_NOINIT | STA_NODISK)) return 0;
+    uint32_t sectors = img.model.card.au_sectors;
+    sectors &= -sectors;
+    return sectors > 32768 ? 32768 : sectors;
+}
+
+static int image_init(sd_card_t *pSD)
+{
+    if (!mutex_is_initialized(&pSD->mutex)) mutex_init(&pSD->mutex);
+    if (!sd_card_detect(pSD)) return pSD->m_Status;
+    if (!(pSD->m_Status & STA_NOINIT)) return pSD->m_Status;
+    // Da ordem da inicialização do cartão: CMD0, CMD8, ACMD41, CMD58...
+    sleep_ms(20);
+    pSD->sectors = img.store.sectors;
+    pSD->baud_rate = img.model.spi_hz;
+    pSD->m_Status &= ~STA_NOINIT;
+    return pSD->m_Status;
+}
+
+bool sd_init_driver(void)
+{
+    for (size_t i = 0; i < sd_get_num(); ++i) {
+        sd_card_t *pSD = sd_get_by_num(i);
+        if (!pSD->init) pSD->m_Status = STA_NOINIT;
+        pSD->init = image_init;
+        pSD->write_blocks = image_write_blocks;
+        pSD->read_blocks = image_read_blocks;
+    }
+    return true;
+}
+
+/* [] END OF FILE */
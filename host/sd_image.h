@@ -0,0 +1,74 @@
+/* sd_image.h
+Cartão SD simulado para os testes do host: implementa a API do sd_card.h
+sobre uma imagem na RAM ou num arquivo .img mapeado com mmap, no lugar do
+sd_card.c. O glue.c, o FatFs, o f_stream e o f_lines rodam sem mudanças
+por cima dele.
+
+Cada operação custa tempo no relógio virtual do pico_host.h, segundo um
+modelo de latência com os tempos de ocupado de um cartão real: o acesso de
+leitura (NAC), o ocupado depois de cada bloco escrito, o do Stop Tran, uma
+penalidade ao mudar de unidade de alocação e picos periódicos de coleta de
+lixo. Como no driver real, o ocupado depois de um CMD24 só é esperado no
+comando seguinte. As escritas e leituras assíncronas terminam (e copiam os
+dados) quando o relógio alcança o fim calculado.
+
+O padrão é o cartão de sd_model_default a 25 MHz.
+*/
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "sd_model.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    uint32_t spi_hz;   // SCK: custo de cada byte no barramento
+    uint32_t cmd_us;   // Custo fixo de cada comando (seleção, pacote, R1)
+    sd_model_t card;   // Tempos de ocupado do cartão
+} sd_image_model_t;
+
+/* Falhas injetadas. Os contadores são das transações (um CMD24, CMD25,
+CMD17 ou CMD18 cada); a transação que falha não altera a imagem. */
+typedef struct {
+    uint32_t fail_write_at;     // Falha a N-ésima escrita (1 = a primeira); 0 desliga
+    uint32_t fail_write_every;  // Falha uma em cada N escritas; 0 desliga
+    uint32_t fail_read_at;
+    uint32_t fail_read_every;
+    int write_error;            // Códigos devolvidos; 0 escolhe
+    int read_error;             // SD_BLOCK_DEVICE_ERROR_WRITE e _CRC
+} sd_image_faults_t;
+
+typedef struct {
+    uint32_t reads;             // Transações
+    uint32_t writes;
+    uint64_t blocks_read;
+    uint64_t blocks_written;
+    uint32_t read_errors;       // Injetados
+    uint32_t write_errors;
+    uint64_t busy_us;           // Tempo de ocupado do cartão (escritas)
+    uint64_t wait_busy_us;      // Parte dele que um comando teve que esperar
+} sd_image_stats_t;
+
+/* Abre uma imagem zerada na RAM, ou um arquivo mapeado (criado ou estendido
+até sectors setores; sectors 0 usa o tamanho do arquivo). Fecha a anterior e
+zera modelo, falhas e contadores. O cartão aparece como inserido, mas não
+inicializado, como depois de ligar. */
+bool sd_image_open_ram(uint64_t sectors);
+bool sd_image_open_file(const char *path, uint64_t sectors);
+// Fecha a imagem (msync no arquivo): o cartão passa a estar ausente
+void sd_image_close(void);
+
+sd_image_model_t *sd_image_model(void);
+sd_image_faults_t *sd_image_faults(void);
+sd_image_stats_t *sd_image_stats(void);
+uint8_t *sd_image_data(void);  // Os setores, para conferir o conteúdo
+
+#ifdef __cplusplus
+}
+#endif
+
+/* [] END OF FILE */
@@ -0,0 +1,100 @@
+/* sd_model.c
+Tempos de ocupado e imagem dos cartões simulados: ver sd_model.h.
+*/
+#include <fcntl.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "sd_model.h"
+
+#define BLOCK 512
+
+const sd_model_t sd_model_default = {
+    .read_access_us = 300,
+    .write_busy_us = 250,
+    .write_cmd_busy_us = 800,
+    .stop_busy_us = 1500,
+    .au_sectors = 8192,  // 4 MiB
+    .au_busy_us = 5000,
+    .spike_every = 2048,
+    .spike_us = 20000,
+};
+
+void sd_model_reset(sd_model_state_t *s)
+{
+    s->last_au = UINT64_MAX;
+    s->spike_count = 0;
+    s->busy_us = 0;
+}
+
+uint32_t sd_model_block_busy_us(const sd_model_t *m, sd_model_state_t *s,
+                                uint64_t sector, bool first)
+{
+    uint32_t us = m->write_busy_us;
+    if (first) us += m->write_cmd_busy_us;
+    if (m->au_sectors) {
+        uint64_t au = sector / m->au_sectors;
+        if (au != s->last_au) {
+            if (UINT64_MAX != s->last_au) us += m->au_busy_us;
+            s->last_au = au;
+        }
+    }
+    if (m->spike_every && ++s->spike_count >= m->spike_every) {
+        s->spike_count = 0;
+        us += m->spike_us;
+    }
+    s->busy_us += us;
+    return us;
+}
+
+bool sd_store_open_ram(sd_store_t *st, uint64_t sectors)
+{
+    st->data = calloc(sectors, BLOCK);
+    st->sectors = st->data ? sectors : 0;
+    st->fd = -1;
+    return st->data;
+}
+
+bool sd_store_open_file(sd_store_t *st, const char *path, uint64_t sectors)
+{
+    st->data = NULL;
+    st->sectors = 0;
+    st->fd = -1;
+    int fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (fd < 0) return false;
+    struct stat sb;
+    if (fstat(fd, &sb) < 0) goto fail;
+    if (!sectors) sectors = sb.st_size / BLOCK;
+    if (!sectors) goto fail;
+    if ((uint64_t)sb.st_size < sectors * BLOCK &&
+        ftruncate(fd, sectors * BLOCK) < 0)
+        goto fail;
+    void *p = mmap(NULL, sectors * BLOCK, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (MAP_FAILED == p) goto fail;
+    st->data = p;
+    st->sectors = sectors;
+    st->fd = fd;
+    return true;
+fail:
+    close(fd);
+    return false;
+}
+
+void sd_store_close(sd_store_t *st)
+{
+    if (!st->data) return;
+    if (st->fd >= 0) {
+        msync(st->data, st->sectors * BLOCK, MS_SYNC);
+        munmap(st->data, st->sectors * BLOCK);
+        close(st->fd);
+    } else {
+        free(st->data);
+    }
+    st->data = NULL;
+    st->sectors = 0;
+    st->fd = -1;
+}
+
+/* [] END OF FILE */
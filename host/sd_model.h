@@ -0,0 +1,59 @@
+/* sd_model.h
+Tempos de ocupado de um cartão SD, comuns aos dois cartões simulados do
+host (sd_image.c e sd_emu.c), e a imagem onde eles guardam os setores: na
+RAM ou num arquivo .img mapeado com mmap.
+
+Os valores padrão são estimativas de um cartão classe 10, não medidas;
+quem precisa de outro cartão muda o modelo.
+*/
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    uint32_t read_access_us;     // NAC: do comando (ou do bloco anterior) ao token
+    uint32_t write_busy_us;      // Ocupado depois de cada bloco escrito
+    uint32_t write_cmd_busy_us;  // Ocupado a mais no primeiro bloco de cada escrita
+    uint32_t stop_busy_us;       // Ocupado depois do Stop Tran de um CMD25
+    uint32_t au_sectors;         // Unidade de alocação, em setores
+    uint32_t au_busy_us;         // Ocupado a mais ao escrever noutra AU
+    uint32_t spike_every;        // A cada tantos blocos escritos, um pico de
+    uint32_t spike_us;           // ocupado (coleta de lixo); 0 desliga
+} sd_model_t;
+
+extern const sd_model_t sd_model_default;
+
+// O que o cartão lembra entre escritas
+typedef struct {
+    uint64_t last_au;
+    uint32_t spike_count;  // Blocos escritos desde o último pico
+    uint64_t busy_us;      // Soma dos ocupados devolvidos
+} sd_model_state_t;
+
+void sd_model_reset(sd_model_state_t *s);
+// Ocupado depois de gravar o bloco sector; first: primeiro bloco do comando
+uint32_t sd_model_block_busy_us(const sd_model_t *m, sd_model_state_t *s,
+                                uint64_t sector, bool first);
+
+typedef struct {
+    uint8_t *data;
+    uint64_t sectors;
+    int fd;  // -1 na RAM
+} sd_store_t;
+
+/* Imagem zerada na RAM, ou um arquivo mapeado, criado ou estendido até
+sectors setores (sectors 0 usa o tamanho do arquivo). */
+bool sd_store_open_ram(sd_store_t *st, uint64_t sectors);
+bool sd_store_open_file(sd_store_t *st, const char *path, uint64_t sectors);
+void sd_store_close(sd_store_t *st);  // msync no arquivo
+
+#ifdef __cplusplus
+}
+#endif
+
+/* [] END OF FILE */
@@ -0,0 +1,137 @@
+/* pico_host.c
+Relógio virtual, eventos agendados e as primitivas de sincronização do
+pico_host.h.
+*/
+#include <stdarg.h>
+#include <stdlib.h>
+
+#include "pico_host.h"
+#include "my_debug.h"
+
+#define MAX_EVENTS 16
+
+typedef struct {
+    uint64_t t_ns;
+    void (*fn)(void *ctx);
+    void *ctx;
+} host_event_t;
+
+static uint64_t now_ns;
+static host_event_t events[MAX_EVENTS];
+static int n_events;
+
+uint64_t host_time_ns(void) { return now_ns; }
+
+void host_schedule(uint64_t t_ns, void (*fn)(void *ctx), void *ctx)
+{
+    if (MAX_EVENTS == n_events) {
+        fprintf(stderr, "host_schedule: fila de eventos cheia\n");
+        abort();
+    }
+    events[n_events++] = (host_event_t){t_ns, fn, ctx};
+}
+
+void host_unschedule(void (*fn)(void *ctx), void *ctx)
+{
+    for (int i = 0; i < n_events; i++) {
+        if (events[i].fn == fn && events[i].ctx == ctx) {
+            events[i--] = events[--n_events];
+        }
+    }
+}
+
+// Índice do próximo evento, ou -1
+static int next_event(void)
+{
+    int next = -1;
+    for (int i = 0; i < n_events; i++) {
+        if (next < 0 || events[i].t_ns < events[next].t_ns) next = i;
+    }
+    return next;
+}
+
+bool host_run_next_event(uint64_t limit_ns)
+{
+    int i = next_event();
+    if (i < 0 || events[i].t_ns > limit_ns) {
+        if (limit_ns > now_ns) now_ns = limit_ns;
+        return false;
+    }
+    host_event_t ev = events[i];
+    events[i] = events[--n_events];
+    if (ev.t_ns > now_ns) now_ns = ev.t_ns;
+    ev.fn(ev.ctx);  // Pode agendar outros eventos
+    return true;
+}
+
+void host_advance_ns(uint64_t ns)
+{
+    uint64_t end = now_ns + ns;
+    while (host_run_next_event(end))
+        ;
+}
+
+void mutex_init(mutex_t *m)
+{
+    m->initialized = true;
+    m->owned = false;
+}
+
+void mutex_enter_blocking(mutex_t *m)
+{
+    // Numa thread só, esperar um mutex ocupado seria um impasse
+    if (!m->initialized || m->owned) {
+        fprintf(stderr, "mutex_enter_blocking: mutex %s\n",
+                m->initialized ? "já ocupado" : "não inicializado");
+        abort();
+    }
+    m->owned = true;
+}
+
+void mutex_exit(mutex_t *m) { m->owned = false; }
+
+void sem_init(semaphore_t *s, int16_t initial_permits, int16_t max_permits)
+{
+    s->permits = initial_permits;
+    s->max_permits = max_permits;
+}
+
+bool sem_release(semaphore_t *s)
+{
+    if (s->permits >= s->max_permits) return false;
+    s->permits++;
+    return true;
+}
+
+bool sem_acquire_timeout_us(semaphore_t *s, uint32_t timeout_us)
+{
+    uint64_t deadline = now_ns + 1000ull * timeout_us;
+    // Só um evento (uma "interrupção") pode liberar o semáforo
+    while (s->permits <= 0) {
+        if (!host_run_next_event(deadline)) return false;
+    }
+    s->permits--;
+    return true;
+}
+
+// Substitutos do my_debug.c, que usa instruções do ARM
+bool host_verbose;
+
+void my_printf(const char *pcFormat, ...)
+{
+    if (!host_verbose) return;
+    va_list args;
+    va_start(args, pcFormat);
+    vprintf(pcFormat, args);
+    va_end(args);
+}
+
+void my_assert_func(const char *file, int line, const char *func,
+                    const char *pred)
+{
+    fprintf(stderr, "assertion \"%s\" failed: file \"%s\", line %d, function: %s\n",
+            pred, file, line, func);
+    abort();
+}
+
+/* [] END OF FILE */
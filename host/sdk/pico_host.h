@@ -0,0 +1,120 @@
+/* pico_host.h
+O pedaço do SDK do Pico que a lib/FatFs_SPI usa, para compilar no Linux.
+
+O tempo é virtual: time_us_64() só anda quando alguém o faz andar
+(host_advance_ns(), sleep_ms(), busy_wait_us(), tight_loop_contents()) ou
+quando um modelo de hardware cobra o custo de uma operação. Assim as medidas
+dos testes e benchmarks do host são determinísticas e dizem respeito ao
+modelo, não à máquina que os executa.
+
+Tudo roda numa única thread; mutex e semáforos só verificam o uso.
+*/
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef unsigned int uint;
+typedef uint64_t absolute_time_t;
+typedef volatile uint32_t io_rw_32;
+typedef volatile uint32_t io_ro_32;
+typedef volatile uint32_t io_wo_32;
+
+#define __not_in_flash_func(f) f
+#define __time_critical_func(f) f
+#define count_of(a) (sizeof(a) / sizeof((a)[0]))
+#define PICO_OK 0
+#define PICO_ERROR_TIMEOUT -1
+#define PICO_ERROR_GENERIC -2
+
+// ---------------------------------------------------------------------------
+// Tempo virtual
+// ---------------------------------------------------------------------------
+
+uint64_t host_time_ns(void);
+// Avança o relógio, executando no caminho os eventos agendados
+void host_advance_ns(uint64_t ns);
+// Agenda fn(ctx) para o instante t_ns (no passado: na próxima vez que o
+// relógio andar). Faz o papel das interrupções de fim de transferência.
+void host_schedule(uint64_t t_ns, void (*fn)(void *ctx), void *ctx);
+void host_unschedule(void (*fn)(void *ctx), void *ctx);
+// Avança até o próximo evento agendado, sem passar de limit_ns. Retorna
+// false se não havia evento antes do limite (o relógio fica em limit_ns).
+bool host_run_next_event(uint64_t limit_ns);
+
+// Liga as mensagens de my_printf() (DBG_PRINTF) do driver
+extern bool host_verbose;
+
+// Custo de uma volta dos laços de espera (tight_loop_contents)
+#define HOST_LOOP_NS 1000
+
+static inline uint64_t time_us_64(void) { return host_time_ns() / 1000; }
+static inline uint32_t time_us_32(void) { return (uint32_t)time_us_64(); }
+static inline absolute_time_t get_absolute_time(void) { return time_us_64(); }
+static inline uint64_t to_us_since_boot(absolute_time_t t) { return t; }
+static inline absolute_time_t make_timeout_time_us(uint64_t us) { return time_us_64() + us; }
+static inline absolute_time_t make_timeout_time_ms(uint32_t ms) { return time_us_64() + 1000ull * ms; }
+static inline absolute_time_t delayed_by_us(absolute_time_t t, uint64_t us) { return t + us; }
+static inline absolute_time_t delayed_by_ms(absolute_time_t t, uint32_t ms) { return t + 1000ull * ms; }
+static inline int64_t absolute_time_diff_us(absolute_time_t from, absolute_time_t to)
+{
+    return (int64_t)(to - from);
+}
+static inline bool time_reached(absolute_time_t t) { return time_us_64() >= t; }
+static inline void busy_wait_us(uint64_t us) { host_advance_ns(us * 1000); }
+static inline void busy_wait_us_32(uint32_t us) { host_advance_ns(us * 1000ull); }
+static inline void sleep_us(uint64_t us) { host_advance_ns(us * 1000); }
+static inline void sleep_ms(uint32_t ms) { host_advance_ns(ms * 1000000ull); }
+static inline void tight_loop_contents(void) { host_advance_ns(HOST_LOOP_NS); }
+
+// ---------------------------------------------------------------------------
+// Sincronização
+// ---------------------------------------------------------------------------
+
+typedef struct {
+    bool initialized;
+    bool owned;
+} mutex_t;
+#define auto_init_mutex(name) static mutex_t name = {true, false}
+
+void mutex_init(mutex_t *m);
+static inline bool mutex_is_initialized(mutex_t *m) { return m->initialized; }
+void mutex_enter_blocking(mutex_t *m);
+void mutex_exit(mutex_t *m);
+
+typedef struct {
+    int16_t permits;
+    int16_t max_permits;
+} semaphore_t;
+
+void sem_init(semaphore_t *s, int16_t initial_permits, int16_t max_permits);
+static inline int sem_available(semaphore_t *s) { return s->permits; }
+bool sem_release(semaphore_t *s);
+static inline void sem_reset(semaphore_t *s, int16_t permits) { s->permits = permits; }
+// Espera avançando o relógio até o próximo evento agendado
+bool sem_acquire_timeout_us(semaphore_t *s, uint32_t timeout_us);
+static inline bool sem_acquire_timeout_ms(semaphore_t *s, uint32_t timeout_ms)
+{
+    return sem_acquire_timeout_us(s, timeout_ms * 1000u);
+}
+
+// Barreiras: o teste do anel roda produtor e consumidor em pthreads
+static inline void __mem_fence_acquire(void) { __atomic_thread_fence(__ATOMIC_ACQUIRE); }
+static inline void __mem_fence_release(void) { __atomic_thread_fence(__ATOMIC_RELEASE); }
+static inline void __dmb(void) { __atomic_thread_fence(__ATOMIC_SEQ_CST); }
+static inline void __compiler_memory_barrier(void) { __atomic_signal_fence(__ATOMIC_SEQ_CST); }
+static inline uint32_t save_and_disable_interrupts(void) { return 0; }
+static inline void restore_interrupts(uint32_t status) { (void)status; }
+static inline uint get_core_num(void) { return 0; }
+
+#ifdef __cplusplus
+}
+#endif
+
+/* [] END OF FILE */
@@ -0,0 +1,399 @@
+/* pico_host_hw.c
+GPIO, SPI, DMA e interrupções do modelo de hardware: ver pico_host_hw.h.
+*/
+#include <stdlib.h>
+#include <string.h>
+
+#include "pico_host_hw.h"
+
+static void irq_raise(uint num);
+
+static void host_fatal(const char *msg)
+{
+    fprintf(stderr, "pico_host_hw: %s\n", msg);
+    abort();
+}
+
+// ---------------------------------------------------------------------------
+// GPIO
+// ---------------------------------------------------------------------------
+
+static struct {
+    bool value;
+    void (*hook)(bool value, void *ctx);
+    void *ctx;
+} gpios[NUM_BANK0_GPIOS];
+
+void gpio_init(uint gpio) { (void)gpio; }
+void gpio_set_dir(uint gpio, bool out) { (void)gpio, (void)out; }
+void gpio_set_function(uint gpio, uint fn) { (void)gpio, (void)fn; }
+void gpio_set_drive_strength(uint gpio, enum gpio_drive_strength drive)
+{
+    (void)gpio, (void)drive;
+}
+
+void gpio_pull_up(uint gpio)
+{
+    if (!gpios[gpio].hook) gpios[gpio].value = true;
+}
+
+void gpio_put(uint gpio, bool value)
+{
+    bool changed = gpios[gpio].value != value;
+    gpios[gpio].value = value;
+    if (changed && gpios[gpio].hook) gpios[gpio].hook(value, gpios[gpio].ctx);
+}
+
+bool gpio_get(uint gpio) { return gpios[gpio].value; }
+
+void host_gpio_set_hook(uint gpio, void (*fn)(bool value, void *ctx), void *ctx)
+{
+    gpios[gpio].hook = fn;
+    gpios[gpio].ctx = ctx;
+}
+
+// ---------------------------------------------------------------------------
+// SPI
+// ---------------------------------------------------------------------------
+
+spi_inst_t host_spi_inst[2] = {{.index = 0}, {.index = 1}};
+
+void host_spi_attach(spi_inst_t *spi, host_spi_exchange_t exchange, void *ctx)
+{
+    spi->exchange = exchange;
+    spi->ctx = ctx;
+}
+
+uint64_t host_spi_bytes_ns(const spi_inst_t *spi, size_t n)
+{
+    return (uint64_t)n * 8 * 1000000000ull / spi->baudrate;
+}
+
+static uint8_t spi_exchange(spi_inst_t *spi, uint8_t mosi, uint64_t t_ns)
+{
+    return spi->exchange ? spi->exchange(spi->ctx, mosi, t_ns) : 0xFF;
+}
+
+// O algoritmo do SDK: prescaler par de 2 a 254 e pós-divisor de 1 a 256
+uint spi_set_baudrate(spi_inst_t *spi, uint baudrate)
+{
+    const uint freq_in = HOST_CLK_PERI_HZ;
+    uint prescale, postdiv;
+    for (prescale = 2; prescale <= 254; prescale += 2) {
+        if (freq_in < (prescale + 2) * 256 * (uint64_t)baudrate) break;
+    }
+    if (prescale > 254) host_fatal("frequência do SPI baixa demais");
+    for (postdiv = 256; postdiv > 1; --postdiv) {
+        if (freq_in / (prescale * (postdiv - 1)) > baudrate) break;
+    }
+    spi->baudrate = freq_in / (prescale * postdiv);
+    return spi->baudrate;
+}
+
+uint spi_get_baudrate(const spi_inst_t *spi) { return spi->baudrate; }
+
+uint spi_init(spi_inst_t *spi, uint baudrate)
+{
+    return spi_set_baudrate(spi, baudrate);
+}
+
+void spi_set_format(spi_inst_t *spi, uint data_bits, spi_cpol_t cpol,
+                    spi_cpha_t cpha, spi_order_t order)
+{
+    (void)spi, (void)cpol, (void)cpha, (void)order;
+    if (8 != data_bits) host_fatal("só há modelo para palavras de 8 bits");
+}
+
+// Os bytes saem um atrás do outro, cada um no seu instante
+static void spi_polled(spi_inst_t *spi, const uint8_t *src, uint8_t fill,
+                       uint8_t *dst, size_t len)
+{
+    host_advance_ns(HOST_SPI_CALL_NS);
+    uint64_t byte_ns = host_spi_bytes_ns(spi, 1);
+    for (size_t i = 0; i < len; i++) {
+        uint8_t miso = spi_exchange(spi, src ? src[i] : fill, host_time_ns());
+        if (dst) dst[i] = miso;
+        host_advance_ns(byte_ns);
+    }
+}
+
+int spi_write_read_blocking(spi_inst_t *spi, const uint8_t *src, uint8_t *dst,
+                            size_t len)
+{
+    spi_polled(spi, src, 0, dst, len);
+    return (int)len;
+}
+
+int spi_write_blocking(spi_inst_t *spi, const uint8_t *src, size_t len)
+{
+    spi_polled(spi, src, 0, NULL, len);
+    return (int)len;
+}
+
+int spi_read_blocking(spi_inst_t *spi, uint8_t repeated_tx_data, uint8_t *dst,
+                      size_t len)
+{
+    spi_polled(spi, NULL, repeated_tx_data, dst, len);
+    return (int)len;
+}
+
+// ---------------------------------------------------------------------------
+// DMA
+// ---------------------------------------------------------------------------
+
+dma_hw_t host_dma_hw;
+
+static struct {
+    bool claimed;
+    bool busy;
+    bool irq0;
+    bool irq1;
+    dma_channel_config cfg;
+    volatile void *write_addr;
+    const volatile void *read_addr;
+    uint count;
+} chans[NUM_DMA_CHANNELS];
+
+static struct {
+    bool enabled;
+    uint channel;
+} sniffer;
+
+// Transferência SPI em andamento, uma por SPI
+typedef struct {
+    spi_inst_t *spi;
+    int tx;  // Canais; -1 se ausente
+    int rx;
+    uint64_t t0_ns;  // Primeiro byte no barramento
+} spi_dma_t;
+
+static spi_dma_t spi_dmas[2];
+
+uint16_t host_crc16_ccitt(uint16_t crc, const uint8_t *data, size_t len)
+{
+    for (size_t i = 0; i < len; i++) {
+        crc ^= (uint16_t)data[i] << 8;
+        for (int b = 0; b < 8; b++) {
+            crc = crc & 0x8000 ? (uint16_t)(crc << 1) ^ 0x1021 : (uint16_t)(crc << 1);
+        }
+    }
+    return crc;
+}
+
+static void sniff(uint channel, uint8_t byte)
+{
+    if (sniffer.enabled && sniffer.channel == channel && chans[channel].cfg.sniff_enable) {
+        dma_hw->sniff_data = host_crc16_ccitt((uint16_t)dma_hw->sniff_data, &byte, 1);
+    }
+}
+
+int dma_claim_unused_channel(bool required)
+{
+    for (int ch = 0; ch < NUM_DMA_CHANNELS; ch++) {
+        if (!chans[ch].claimed) {
+            chans[ch].claimed = true;
+            return ch;
+        }
+    }
+    if (required) host_fatal("sem canais de DMA livres");
+    return -1;
+}
+
+dma_channel_config dma_channel_get_default_config(uint channel)
+{
+    (void)channel;
+    return (dma_channel_config){
+        .read_increment = true,
+        .write_increment = false,
+        .sniff_enable = false,
+        .dreq = DREQ_FORCE,
+        .transfer_data_size = DMA_SIZE_32,
+    };
+}
+
+// Fim de um canal: limpa busy e levanta as interrupções habilitadas
+static void finish_channels(uint32_t mask)
+{
+    uint32_t ints0 = 0, ints1 = 0;
+    for (uint ch = 0; ch < NUM_DMA_CHANNELS; ch++) {
+        if (!(mask & (1u << ch))) continue;
+        chans[ch].busy = false;
+        if (chans[ch].irq0) ints0 |= 1u << ch;
+        if (chans[ch].irq1) ints1 |= 1u << ch;
+    }
+    if (ints0) {
+        dma_hw->ints0 |= ints0;
+        irq_raise(DMA_IRQ_0);
+        dma_hw->ints0 &= ~ints0;  // O handler escreveu 1 para limpar
+    }
+    if (ints1) {
+        dma_hw->ints1 |= ints1;
+        irq_raise(DMA_IRQ_1);
+        dma_hw->ints1 &= ~ints1;
+    }
+}
+
+static spi_inst_t *spi_of_addr(const volatile void *addr)
+{
+    for (int i = 0; i < 2; i++) {
+        if (addr == &host_spi_inst[i].hw.dr) return &host_spi_inst[i];
+    }
+    return NULL;
+}
+
+static void spi_dma_done(void *ctx)
+{
+    spi_dma_t *t = ctx;
+    uint64_t byte_ns = host_spi_bytes_ns(t->spi, 1);
+    uint count = chans[t->tx].count;
+    const uint8_t *src = (const uint8_t *)chans[t->tx].read_addr;
+    uint8_t *dst = (uint8_t *)chans[t->rx].write_addr;
+    for (uint i = 0; i < count; i++) {
+        uint8_t mosi = src[chans[t->tx].cfg.read_increment ? i : 0];
+        sniff(t->tx, mosi);
+        uint8_t miso = spi_exchange(t->spi, mosi, t->t0_ns + i * byte_ns);
+        sniff(t->rx, miso);
+        dst[chans[t->rx].cfg.write_increment ? i : 0] = miso;
+    }
+    t->spi = NULL;
+    finish_channels((1u << t->tx) | (1u << t->rx));
+}
+
+// Memória para memória: acontece na hora
+static void mem_dma(uint ch)
+{
+    uint size = 1u << chans[ch].cfg.transfer_data_size;
+    const uint8_t *src = (const uint8_t *)chans[ch].read_addr;
+    uint8_t *dst = (uint8_t *)chans[ch].write_addr;
+    for (uint i = 0; i < chans[ch].count * size; i++) {
+        uint8_t b = src[chans[ch].cfg.read_increment ? i : i % size];
+        sniff(ch, b);
+        dst[chans[ch].cfg.write_increment ? i : i % size] = b;
+    }
+    host_advance_ns(8ull * chans[ch].count);  // Um elemento por ciclo, ~8 ns
+    finish_channels(1u << ch);
+}
+
+void dma_start_channel_mask(uint32_t chan_mask)
+{
+    int tx = -1, rx = -1;
+    for (uint ch = 0; ch < NUM_DMA_CHANNELS; ch++) {
+        if (!(chan_mask & (1u << ch))) continue;
+        if (!chans[ch].claimed) host_fatal("canal de DMA não reservado");
+        chans[ch].busy = true;
+        if (spi_of_addr(chans[ch].write_addr)) {
+            tx = ch;
+        } else if (spi_of_addr(chans[ch].read_addr)) {
+            rx = ch;
+        } else {
+            mem_dma(ch);
+        }
+    }
+    if (tx < 0 && rx < 0) return;
+    // O PL022 só dá clock com dados no FIFO de transmissão, e o driver
+    // sempre dispara os dois canais juntos
+    if (tx < 0 || rx < 0) host_fatal("DMA de SPI sem o par transmissão/recepção");
+    spi_inst_t *spi = spi_of_addr(chans[tx].write_addr);
+    if (spi != spi_of_addr(chans[rx].read_addr) || chans[tx].count != chans[rx].count)
+        host_fatal("canais de DMA de SPI desencontrados");
+    spi_dma_t *t = &spi_dmas[spi->index];
+    if (t->spi) host_fatal("DMA disparado com outro em andamento no mesmo SPI");
+    host_advance_ns(HOST_DMA_START_NS);
+    t->spi = spi;
+    t->tx = tx;
+    t->rx = rx;
+    t->t0_ns = host_time_ns();
+    host_schedule(t->t0_ns + host_spi_bytes_ns(spi, chans[tx].count) + HOST_DMA_IRQ_NS,
+                  spi_dma_done, t);
+}
+
+void dma_channel_configure(uint channel, const dma_channel_config *config,
+                           volatile void *write_addr, const volatile void *read_addr,
+                           uint transfer_count, bool trigger)
+{
+    if (chans[channel].busy) host_fatal("canal de DMA reconfigurado ocupado");
+    chans[channel].cfg = *config;
+    chans[channel].write_addr = write_addr;
+    chans[channel].read_addr = read_addr;
+    chans[channel].count = transfer_count;
+    if (trigger) dma_start_channel_mask(1u << channel);
+}
+
+bool dma_channel_is_busy(uint channel) { return chans[channel].busy; }
+
+void dma_channel_wait_for_finish_blocking(uint channel)
+{
+    while (chans[channel].busy) {
+        if (!host_run_next_event(UINT64_MAX))
+            host_fatal("espera por um canal de DMA que nunca termina");
+    }
+}
+
+void dma_channel_abort(uint channel)
+{
+    for (int i = 0; i < 2; i++) {
+        spi_dma_t *t = &spi_dmas[i];
+        if (t->spi && ((int)channel == t->tx || (int)channel == t->rx)) {
+            host_unschedule(spi_dma_done, t);
+            chans[t->tx].busy = chans[t->rx].busy = false;
+            t->spi = NULL;
+        }
+    }
+    chans[channel].busy = false;
+}
+
+void dma_channel_set_irq0_enabled(uint channel, bool enabled)
+{
+    chans[channel].irq0 = enabled;
+}
+
+void dma_channel_set_irq1_enabled(uint channel, bool enabled)
+{
+    chans[channel].irq1 = enabled;
+}
+
+void dma_sniffer_enable(uint channel, uint mode, bool force_channel_enable)
+{
+    (void)force_channel_enable;
+    if (DMA_SNIFF_CTRL_CALC_VALUE_CRC16 != mode)
+        host_fatal("só há modelo para o CRC16 do sniffer");
+    sniffer.enabled = true;
+    sniffer.channel = channel;
+}
+
+void dma_sniffer_disable(void) { sniffer.enabled = false; }
+
+// ---------------------------------------------------------------------------
+// IRQ
+// ---------------------------------------------------------------------------
+
+#define MAX_SHARED_HANDLERS 4
+
+static struct {
+    bool enabled;
+    irq_handler_t handlers[MAX_SHARED_HANDLERS];
+    int n;
+} irqs[32];
+
+void irq_add_shared_handler(uint num, irq_handler_t handler, uint8_t order_priority)
+{
+    (void)order_priority;
+    if (MAX_SHARED_HANDLERS == irqs[num].n) host_fatal("handlers demais na IRQ");
+    irqs[num].handlers[irqs[num].n++] = handler;
+}
+
+void irq_set_exclusive_handler(uint num, irq_handler_t handler)
+{
+    irqs[num].handlers[0] = handler;
+    irqs[num].n = 1;
+}
+
+void irq_set_enabled(uint num, bool enabled) { irqs[num].enabled = enabled; }
+
+static void irq_raise(uint num)
+{
+    if (!irqs[num].enabled) return;
+    for (int i = 0; i < irqs[num].n; i++) irqs[num].handlers[i]();
+}
+
+/* [] END OF FILE */
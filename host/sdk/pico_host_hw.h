@@ -0,0 +1,224 @@
+/* pico_host_hw.h
+Modelo do hardware que o driver do cartão usa: GPIO, o SPI (PL022), o DMA
+com o sniffer de CRC e as interrupções do DMA.
+
+O SPI troca cada byte com o dispositivo ligado por host_spi_attach(). As
+transferências por polling acontecem na hora e avançam o relógio virtual;
+as de DMA só terminam quando o relógio chega ao fim calculado: aí os bytes
+são trocados (com o instante em que cada um passaria no barramento), o
+sniffer faz a conta, o canal levanta o bit em ints0/ints1 e os handlers da
+interrupção rodam. Os custos em HOST_*_NS são estimativas para um RP2040 a
+125 MHz, não medidas.
+*/
+#pragma once
+
+#include "pico_host.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Custo fixo de uma chamada spi_*_blocking(): entrada, FIFO, espera do fim
+#define HOST_SPI_CALL_NS 500
+// Configurar os dois canais e dispará-los (dois dma_channel_configure)
+#define HOST_DMA_START_NS 2000
+// Entrada na interrupção do DMA até o handler rodar
+#define HOST_DMA_IRQ_NS 1000
+
+#define HOST_CLK_PERI_HZ 125000000u
+
+// ---------------------------------------------------------------------------
+// GPIO
+// ---------------------------------------------------------------------------
+
+#define GPIO_IN 0
+#define GPIO_OUT 1
+#define GPIO_FUNC_SPI 1
+enum gpio_drive_strength {
+    GPIO_DRIVE_STRENGTH_2MA = 0,
+    GPIO_DRIVE_STRENGTH_4MA,
+    GPIO_DRIVE_STRENGTH_8MA,
+    GPIO_DRIVE_STRENGTH_12MA
+};
+
+#define NUM_BANK0_GPIOS 30
+
+void gpio_init(uint gpio);
+void gpio_set_dir(uint gpio, bool out);
+void gpio_set_function(uint gpio, uint fn);
+void gpio_pull_up(uint gpio);
+void gpio_set_drive_strength(uint gpio, enum gpio_drive_strength drive);
+void gpio_put(uint gpio, bool value);
+bool gpio_get(uint gpio);
+// Chamado a cada gpio_put() que muda o nível do pino (o CS do cartão)
+void host_gpio_set_hook(uint gpio, void (*fn)(bool value, void *ctx), void *ctx);
+
+// ---------------------------------------------------------------------------
+// SPI
+// ---------------------------------------------------------------------------
+
+typedef struct {
+    io_rw_32 cr0;
+    io_rw_32 cr1;
+    io_rw_32 dr;
+    io_ro_32 sr;
+    io_rw_32 cpsr;
+    io_rw_32 imsc;
+    io_ro_32 ris;
+    io_ro_32 mis;
+    io_wo_32 icr;
+    io_rw_32 dmacr;
+} spi_hw_t;
+
+typedef struct spi_inst spi_inst_t;
+
+// Um byte trocado com o dispositivo: recebe MOSI, devolve MISO. t_ns é o
+// instante do byte no barramento, que numa transferência por DMA fica no
+// passado em relação ao relógio.
+typedef uint8_t (*host_spi_exchange_t)(void *ctx, uint8_t mosi, uint64_t t_ns);
+
+struct spi_inst {
+    spi_hw_t hw;
+    uint index;
+    uint baudrate;
+    host_spi_exchange_t exchange;  // NULL: nada ligado, MISO fica em 1
+    void *ctx;
+};
+
+extern spi_inst_t host_spi_inst[2];
+#define spi0 (&host_spi_inst[0])
+#define spi1 (&host_spi_inst[1])
+
+typedef enum { SPI_CPOL_0 = 0, SPI_CPOL_1 = 1 } spi_cpol_t;
+typedef enum { SPI_CPHA_0 = 0, SPI_CPHA_1 = 1 } spi_cpha_t;
+typedef enum { SPI_LSB_FIRST = 0, SPI_MSB_FIRST = 1 } spi_order_t;
+
+static inline spi_hw_t *spi_get_hw(spi_inst_t *spi) { return &spi->hw; }
+static inline uint spi_get_index(const spi_inst_t *spi) { return spi->index; }
+
+uint spi_init(spi_inst_t *spi, uint baudrate);
+uint spi_set_baudrate(spi_inst_t *spi, uint baudrate);
+uint spi_get_baudrate(const spi_inst_t *spi);
+void spi_set_format(spi_inst_t *spi, uint data_bits, spi_cpol_t cpol,
+                    spi_cpha_t cpha, spi_order_t order);
+int spi_write_read_blocking(spi_inst_t *spi, const uint8_t *src, uint8_t *dst,
+                            size_t len);
+int spi_write_blocking(spi_inst_t *spi, const uint8_t *src, size_t len);
+int spi_read_blocking(spi_inst_t *spi, uint8_t repeated_tx_data, uint8_t *dst,
+                      size_t len);
+static inline bool spi_is_busy(const spi_inst_t *spi) { (void)spi; return false; }
+static inline bool spi_is_readable(const spi_inst_t *spi) { (void)spi; return false; }
+
+void host_spi_attach(spi_inst_t *spi, host_spi_exchange_t exchange, void *ctx);
+// Duração de n bytes no barramento na frequência atual
+uint64_t host_spi_bytes_ns(const spi_inst_t *spi, size_t n);
+
+// ---------------------------------------------------------------------------
+// DMA
+// ---------------------------------------------------------------------------
+
+#define NUM_DMA_CHANNELS 12
+
+enum dma_channel_transfer_size { DMA_SIZE_8 = 0, DMA_SIZE_16 = 1, DMA_SIZE_32 = 2 };
+
+#define DREQ_SPI0_TX 16
+#define DREQ_SPI0_RX 17
+#define DREQ_SPI1_TX 18
+#define DREQ_SPI1_RX 19
+#define DREQ_FORCE 0x3f
+
+#define DMA_SNIFF_CTRL_CALC_VALUE_CRC16 0x2
+
+typedef struct {
+    io_rw_32 inte0;
+    io_rw_32 ints0;
+    io_rw_32 inte1;
+    io_rw_32 ints1;
+    io_rw_32 sniff_ctrl;
+    io_rw_32 sniff_data;
+} dma_hw_t;
+
+extern dma_hw_t host_dma_hw;
+#define dma_hw (&host_dma_hw)
+
+typedef struct {
+    bool read_increment;
+    bool write_increment;
+    bool sniff_enable;
+    uint dreq;
+    uint transfer_data_size;
+} dma_channel_config;
+
+int dma_claim_unused_channel(bool required);
+dma_channel_config dma_channel_get_default_config(uint channel);
+static inline void channel_config_set_read_increment(dma_channel_config *c, bool incr)
+{
+    c->read_increment = incr;
+}
+static inline void channel_config_set_write_increment(dma_channel_config *c, bool incr)
+{
+    c->write_increment = incr;
+}
+static inline void channel_config_set_dreq(dma_channel_config *c, uint dreq)
+{
+    c->dreq = dreq;
+}
+static inline void channel_config_set_transfer_data_size(dma_channel_config *c,
+                                                         enum dma_channel_transfer_size size)
+{
+    c->transfer_data_size = size;
+}
+static inline void channel_config_set_sniff_enable(dma_channel_config *c, bool sniff)
+{
+    c->sniff_enable = sniff;
+}
+void dma_channel_configure(uint channel, const dma_channel_config *config,
+                           volatile void *write_addr, const volatile void *read_addr,
+                           uint transfer_count, bool trigger);
+void dma_start_channel_mask(uint32_t chan_mask);
+bool dma_channel_is_busy(uint channel);
+void dma_channel_wait_for_finish_blocking(uint channel);
+void dma_channel_abort(uint channel);
+void dma_channel_set_irq0_enabled(uint channel, bool enabled);
+void dma_channel_set_irq1_enabled(uint channel, bool enabled);
+static inline bool dma_channel_get_irq0_status(uint channel)
+{
+    return dma_hw->ints0 & (1u << channel);
+}
+static inline bool dma_channel_get_irq1_status(uint channel)
+{
+    return dma_hw->ints1 & (1u << channel);
+}
+void dma_sniffer_enable(uint channel, uint mode, bool force_channel_enable);
+void dma_sniffer_disable(void);
+static inline void dma_sniffer_set_data_accumulator(uint32_t seed_value)
+{
+    dma_hw->sniff_data = seed_value;
+}
+static inline uint32_t dma_sniffer_get_data_accumulator(void)
+{
+    return dma_hw->sniff_data;
+}
+
+// CRC16-CCITT bit a bit, como o sniffer: independente das tabelas do crc.c
+uint16_t host_crc16_ccitt(uint16_t crc, const uint8_t *data, size_t len);
+
+// ---------------------------------------------------------------------------
+// IRQ
+// ---------------------------------------------------------------------------
+
+#define DMA_IRQ_0 11
+#define DMA_IRQ_1 12
+#define PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY 0x80
+
+typedef void (*irq_handler_t)(void);
+
+void irq_add_shared_handler(uint num, irq_handler_t handler, uint8_t order_priority);
+void irq_set_exclusive_handler(uint num, irq_handler_t handler);
+void irq_set_enabled(uint num, bool enabled);
+
+#ifdef __cplusplus
+}
+#endif
+
+/* [] END OF FILE */
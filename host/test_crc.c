@@ -0,0 +1,114 @@
+/* test_crc.c
+O CRC16 dos blocos de dados: crc16_sliced() (com CRC16_SLICES 4 ou 8,
+conforme o alvo) contra a tabela de um byte por vez (crc16_bytewise()),
+contra uma referência bit a bit e contra o modelo do sniffer de DMA do
+host, com tamanhos, alinhamentos e valores iniciais aleatórios. Depois,
+a vazão de cada um em blocos de 512 bytes, no relógio da máquina.
+*/
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "pico/stdlib.h"
+#include "crc.h"
+#include "host_test.h"
+
+// CRC16-CCITT (XMODEM) bit a bit, direto da definição
+static uint16_t crc16_ref(const uint8_t *data, size_t len, uint16_t crc)
+{
+    for (size_t i = 0; i < len; i++) {
+        crc ^= (uint16_t)data[i] << 8;
+        for (int b = 0; b < 8; b++) crc = crc & 0x8000 ? (uint16_t)(crc << 1) ^ 0x1021 : (uint16_t)(crc << 1);
+    }
+    return crc;
+}
+
+static uint32_t next_rand(uint32_t *x)
+{
+    *x ^= *x << 13;
+    *x ^= *x >> 17;
+    *x ^= *x << 5;
+    return *x;
+}
+
+static void test_equivalence(void)
+{
+    static const char check[] = "123456789";
+    CHECK(0x31C3 == crc16_sliced(check, 9, 0));
+    CHECK(0x31C3 == crc16_bytewise(check, 9));
+    CHECK(0x31C3 == crc16(check, 9));
+    CHECK(0 == crc16_sliced(check, 0, 0) && 0x1234 == crc16_sliced(check, 0, 0x1234));
+
+    static uint8_t buf[4096 + 16];
+    uint32_t rnd = 88172645;
+    for (size_t i = 0; i < sizeof buf; i++) buf[i] = next_rand(&rnd);
+
+    int mismatches = 0;
+    for (int iter = 0; iter < 3000; iter++) {
+        size_t off = next_rand(&rnd) % 16;  // Todos os alinhamentos
+        size_t len = next_rand(&rnd) % 4097;
+        uint16_t init = next_rand(&rnd);
+        const uint8_t *p = buf + off;
+
+        uint16_t ref0 = crc16_ref(p, len, 0), ref = crc16_ref(p, len, init);
+        if (ref0 != crc16_sliced(p, len, 0) ||
+            ref0 != crc16_bytewise((const char *)p, (int)len) ||
+            ref0 != host_crc16_ccitt(0, p, len) ||
+            ref != crc16_sliced(p, len, init) ||
+            ref != host_crc16_ccitt(init, p, len))
+            mismatches++;
+
+        // Em dois pedaços, continuando do CRC do primeiro
+        size_t cut = len ? next_rand(&rnd) % len : 0;
+        uint16_t c = init;
+        update_crc16(&c, (const char *)p, cut);
+        update_crc16(&c, (const char *)p + cut, len - cut);
+        if (ref != c) mismatches++;
+    }
+    CHECK(0 == mismatches);
+
+    // Um bit trocado em qualquer posição do bloco muda o CRC
+    int missed = 0;
+    uint16_t good = crc16_sliced(buf, 512, 0);
+    for (size_t bit = 0; bit < 512 * 8; bit++) {
+        buf[bit / 8] ^= 1 << bit % 8;
+        if (good == crc16_sliced(buf, 512, 0)) missed++;
+        buf[bit / 8] ^= 1 << bit % 8;
+    }
+    CHECK(0 == missed);
+}
+
+static double now_s(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static volatile uint16_t sink;
+
+static void bench(void)
+{
+    static uint8_t block[512];
+    for (size_t i = 0; i < sizeof block; i++) block[i] = i * 31 + 7;
+    const int blocks = 50000;
+    double t0 = now_s();
+    for (int i = 0; i < blocks; i++) sink = crc16_bytewise((const char *)block, sizeof block);
+    double bytewise = now_s() - t0;
+    t0 = now_s();
+    for (int i = 0; i < blocks; i++) sink = crc16_sliced(block, sizeof block, 0);
+    double sliced = now_s() - t0;
+    double mb = blocks * 512.0 / 1e6;
+    printf("crc16_bytewise: %.0f MB/s\n", mb / bytewise);
+    printf("crc16_sliced (%d bytes por passo): %.0f MB/s, %.2fx\n", CRC16_SLICES, mb / sliced,
+           bytewise / sliced);
+}
+
+int main(void)
+{
+    test_equivalence();
+    bench();
+    return host_test_result("test_crc");
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,363 @@
+/* test_emu.c
+O driver de verdade (sd_card.c, sd_spi.c e spi.c) sobre o cartão emulado no
+modo SPI (sd_emu.c): inicialização, comandos contados dos dois lados, bytes
+no barramento, negociação do SCK, falhas injetadas e escritas assíncronas.
+*/
+#include <stdlib.h>
+#include <string.h>
+
+#include "pico/stdlib.h"
+#include "ff.h"
+#include "diskio.h"
+#include "disk_async.h"
+#include "f_stream.h"
+#include "f_util.h"
+#include "host_test.h"
+#include "hw_config.h"
+#include "sd_emu.h"
+
+#define SECTORS (32ull * 1024 * 1024 / 512)  // 32 MiB
+#define FILE_BYTES (1024 * 1024 + 333)
+
+static uint8_t pattern(uint32_t i) { return (uint8_t)(i * 2654435761u >> 24); }
+
+static sd_card_t *card(void) { return sd_get_by_num(0); }
+
+// Cada quadro de comando do driver chegou ao cartão, e nada mais
+static bool same_commands(void)
+{
+    sd_emu_stats_t *st = sd_emu_stats();
+    for (int i = 0; i < 64; i++) {
+        if (card()->stats.commands[i] != st->commands[i] + st->acmds[i]) {
+            printf("CMD%d: driver %lu, cartão %lu + %lu\n", i,
+                   (unsigned long)card()->stats.commands[i],
+                   (unsigned long)st->commands[i], (unsigned long)st->acmds[i]);
+            return false;
+        }
+    }
+    return true;
+}
+
+// Comandos que chegaram ao cartão desde a abertura, como o drop_cmd_at conta
+static uint32_t commands_seen(void)
+{
+    sd_emu_stats_t *st = sd_emu_stats();
+    uint32_t n = st->crc7_errors + st->illegal_commands + st->dropped_commands;
+    for (int i = 0; i < 64; i++) n += st->commands[i] + st->acmds[i];
+    return n;
+}
+
+static void reset_counters(void)
+{
+    memset(&card()->stats, 0, sizeof card()->stats);
+    memset(sd_emu_stats(), 0, sizeof *sd_emu_stats());
+}
+
+// Os bytes com CS baixo, pelo papel de cada um, somam o total
+static bool wire_adds_up(void)
+{
+    sd_emu_stats_t *st = sd_emu_stats();
+    return st->wire_bytes == st->cmd_bytes + st->resp_bytes + st->data_bytes +
+                                 st->overhead_bytes + st->busy_bytes +
+                                 st->wait_bytes + st->idle_bytes;
+}
+
+static void test_init(void)
+{
+    CHECK(sd_emu_open_ram(SECTORS));
+    reset_counters();
+    CHECK(0 == (disk_initialize(0) & STA_NOINIT));
+    CHECK(SECTORS == card()->sectors);
+    CHECK(card()->spi->crc16_sniff);
+    CHECK(20833333 == card()->baud_rate);  // 25 MHz pedidos, o divisor dá isto
+    CHECK(0 == card()->clock_step_downs);
+
+    sd_emu_stats_t *st = sd_emu_stats();
+    CHECK(same_commands());
+    CHECK(0 == st->crc7_errors && 0 == st->illegal_commands);
+    CHECK(st->commands[0] && st->commands[8] && st->commands[59] && st->commands[58]);
+    CHECK(st->acmds[41] && st->commands[55] >= st->acmds[41]);
+    CHECK(1 == st->commands[9] && 1 == st->commands[16]);
+    // Os 74 clocks com CS alto antes do CMD0
+    CHECK(st->cs_high_bytes >= 10);
+    // Setor 0 lido como referência e 4 vezes no primeiro degrau que passa
+    CHECK(5 == st->blocks_read && 0 == st->read_crc_faults);
+    CHECK(wire_adds_up());
+
+    // O padrão da biblioteca confere cada escrita; o datalogger opta pelo
+    // CMD13 só no sync (hw_config.c da raiz), e os testes seguintes também
+    CHECK(SD_STATUS_CHECK_EVERY_WRITE == card()->status_check);
+    card()->status_check = SD_STATUS_CHECK_ON_SYNC;
+}
+
+static void write_file(const char *path, uint32_t bytes)
+{
+    FIL fil;
+    static uint8_t buf[8 * 1024];
+    CHECK_FR(f_open(&fil, path, FA_CREATE_ALWAYS | FA_WRITE));
+    for (uint32_t off = 0; off < bytes;) {
+        UINT n = bytes - off < sizeof buf ? bytes - off : sizeof buf, bw;
+        for (UINT i = 0; i < n; i++) buf[i] = pattern(off + i);
+        CHECK_FR(f_write(&fil, buf, n, &bw));
+        CHECK(bw == n);
+        off += n;
+    }
+    CHECK_FR(f_close(&fil));
+}
+
+static bool verify_file(const char *path, uint32_t bytes)
+{
+    FIL fil;
+    static uint8_t buf[5000];  // Fora de setor, de propósito
+    bool ok = FR_OK == f_open(&fil, path, FA_READ) && f_size(&fil) == bytes;
+    for (uint32_t off = 0; ok && off < bytes;) {
+        UINT br;
+        ok = FR_OK == f_read(&fil, buf, sizeof buf, &br) && br;
+        for (UINT i = 0; ok && i < br; i++) ok = buf[i] == pattern(off + i);
+        off += br;
+    }
+    f_close(&fil);
+    return ok;
+}
+
+typedef struct {
+    uint32_t off;
+    bool ok;
+} stream_check_t;
+
+static bool stream_sink(const void *data, size_t len, void *ctx)
+{
+    stream_check_t *c = ctx;
+    const uint8_t *p = data;
+    for (size_t i = 0; i < len; i++) {
+        if (p[i] != pattern(c->off + i)) c->ok = false;
+    }
+    c->off += len;
+    return true;
+}
+
+static void test_files(void)
+{
+    static FATFS fs;
+    static uint8_t work[FF_MAX_SS];
+    MKFS_PARM opt = {FM_ANY, 0, 0, 0, 0};
+    reset_counters();
+    CHECK_FR(f_mkfs("0:", &opt, work, sizeof work));
+    CHECK_FR(f_mount(&fs, "0:", 1));
+    write_file("0:/dados.bin", FILE_BYTES);
+    CHECK(verify_file("0:/dados.bin", FILE_BYTES));
+
+    // f_stream: CMD18 pela fila assíncrona, com o CRC do sniffer
+    FIL fil;
+    static uint8_t buf[2 * 32 * 1024];
+    stream_check_t c = {0, true};
+    CHECK_FR(f_open(&fil, "0:/dados.bin", FA_READ));
+    CHECK_FR(f_stream(&fil, buf, sizeof buf, stream_sink, &c));
+    CHECK(c.ok && FILE_BYTES == c.off);
+    CHECK(card()->stats.async_reads > 0);
+
+    // Os setores do arquivo estão mesmo na imagem
+    LBA_t lba = fs.database + (LBA_t)(fil.obj.sclust - 2) * fs.csize;
+    CHECK(0 == memcmp(sd_emu_data() + lba * 512, (uint8_t[]){pattern(0), pattern(1), pattern(2)}, 3));
+    CHECK_FR(f_close(&fil));
+    CHECK_FR(f_unmount("0:"));
+
+    sd_emu_stats_t *st = sd_emu_stats();
+    CHECK(same_commands());
+    CHECK(0 == st->crc7_errors && 0 == st->illegal_commands);
+    CHECK(0 == st->read_crc_faults && 0 == st->write_crc_errors && 0 == st->write_errors);
+    CHECK(st->commands[25] && st->acmds[23] && st->commands[18] && st->commands[12]);
+    // Com SD_STATUS_CHECK_ON_SYNC, um CMD13 por sincronização, não por escrita
+    CHECK(st->commands[13] < st->commands[24] + st->commands[25]);
+    // Blocos, o SD Status do ACMD13 e o CSD do CMD9 (GET_SECTOR_COUNT)
+    CHECK(512 * (st->blocks_read + st->blocks_written) + 64 * st->acmds[13] +
+              16 * st->commands[9] == st->data_bytes);
+    CHECK(card()->stats.blocks_written == st->blocks_written);
+    CHECK(wire_adds_up());
+}
+
+static void report_wire(const char *what)
+{
+    sd_emu_stats_t *st = sd_emu_stats();
+    printf("%s: %llu bytes no barramento, %.1f%% de dados, %llu esperando, %llu ocupado\n",
+           what, (unsigned long long)st->wire_bytes, 100.0 * st->data_bytes / st->wire_bytes,
+           (unsigned long long)st->wait_bytes, (unsigned long long)st->busy_bytes);
+}
+
+// Bytes no barramento de uma leitura e de uma escrita, contados um a um
+static void test_wire(void)
+{
+    static uint8_t a[8 * 512], b[8 * 512];
+    sd_emu_stats_t *st = sd_emu_stats();
+    CHECK(RES_OK == disk_ioctl(0, CTRL_SYNC, NULL));
+
+    // CMD18 de 8 blocos: comando, 8 × (token, dados, CRC16), CMD12
+    reset_counters();
+    CHECK(RES_OK == disk_read(0, b, 100, 8));
+    CHECK(0 == memcmp(b, sd_emu_data() + 100 * 512, sizeof b));
+    CHECK(1 == st->commands[18] && 1 == st->commands[12]);
+    CHECK(8 * 512 == st->data_bytes && 8 * 3 == st->overhead_bytes);
+    CHECK(12 == st->cmd_bytes);
+    // NCR e R1 do CMD18; o byte de enchimento e o R1 do CMD12
+    CHECK(4 == st->resp_bytes);
+    CHECK(st->wait_bytes > 0);  // NAC antes de cada bloco
+    CHECK(wire_adds_up());
+    report_wire("CMD18, 8 blocos");
+
+    // CMD24: token, dados, CRC16 e a resposta de dados; o ocupado fica
+    // para o próximo comando
+    for (int i = 0; i < 512; i++) a[i] = pattern(i + 7);
+
+    // Com o padrão da biblioteca, o CMD13 vem logo após a escrita
+    card()->status_check = SD_STATUS_CHECK_EVERY_WRITE;
+    reset_counters();
+    CHECK(RES_OK == disk_write(0, a, 199, 1));
+    CHECK(1 == st->commands[24] && 1 == st->commands[13]);
+    card()->status_check = SD_STATUS_CHECK_ON_SYNC;
+    CHECK(RES_OK == disk_ioctl(0, CTRL_SYNC, NULL));
+
+    reset_counters();
+    CHECK(RES_OK == disk_write(0, a, 200, 1));
+    CHECK(1 == st->commands[24] && 1 == st->blocks_written);
+    CHECK(512 == st->data_bytes && 4 == st->overhead_bytes);
+    CHECK(0 == memcmp(a, sd_emu_data() + 200 * 512, 512));
+    CHECK(RES_OK == disk_ioctl(0, CTRL_SYNC, NULL));
+    CHECK(st->busy_bytes > 0 && 1 == st->commands[13]);
+
+    // CMD25 de 8 blocos: ACMD23, 8 × (token, dados, CRC16, resposta) e o
+    // Stop Tran
+    for (int i = 0; i < (int)sizeof a; i++) a[i] = pattern(i + 11);
+    reset_counters();
+    CHECK(RES_OK == disk_write(0, a, 300, 8));
+    CHECK(1 == st->commands[25] && 1 == st->acmds[23]);
+    CHECK(8 * 512 == st->data_bytes && 8 * 4 + 1 == st->overhead_bytes);
+    CHECK(0 == memcmp(a, sd_emu_data() + 300 * 512, sizeof a));
+    CHECK(same_commands());
+    CHECK(wire_adds_up());
+    report_wire("CMD25, 8 blocos");
+
+    // Todo byte que o SPI trocou passou pelo cartão, com CS alto ou baixo;
+    // os bytes da seleção e da desseleção o sd_spi.c escreve direto
+    spi_t *spi = card()->spi;
+    spi->dma_bytes = spi->polled_bytes = 0;
+    reset_counters();
+    CHECK(RES_OK == disk_read(0, b, 300, 8));
+    CHECK(spi->dma_bytes + spi->polled_bytes + 2 == st->wire_bytes + st->cs_high_bytes);
+}
+
+// Um SCK que o cartão não aguenta: a negociação desce até 12,5 MHz
+static void test_clock(void)
+{
+    CHECK(sd_emu_open_ram(SECTORS));
+    sd_emu_model()->max_hz = 15000000;
+    reset_counters();
+    CHECK(0 == (disk_initialize(0) & STA_NOINIT));
+    CHECK(12500000 == card()->baud_rate);
+    CHECK(sd_emu_stats()->read_crc_faults > 0);
+    CHECK(card()->stats.crc_errors > 0);
+
+    // Lido e escrito sem erros no SCK negociado
+    static uint8_t a[4 * 512], b[4 * 512];
+    for (int i = 0; i < (int)sizeof a; i++) a[i] = pattern(i);
+    reset_counters();
+    CHECK(RES_OK == disk_write(0, a, 40, 4));
+    CHECK(RES_OK == disk_read(0, b, 40, 4));
+    CHECK(0 == memcmp(a, b, sizeof a));
+    CHECK(0 == sd_emu_stats()->read_crc_faults && 0 == sd_emu_stats()->write_crc_errors);
+
+    // O cartão piora depois da negociação: três leituras com CRC errado
+    // descem o clock, e a leitura ainda ganha uma tentativa no novo SCK
+    sd_emu_model()->max_hz = 10000000;
+    uint32_t retries = card()->stats.transfer_retries;
+    memset(b, 0, sizeof b);
+    CHECK(RES_OK == disk_read(0, b, 40, 4));
+    CHECK(0 == memcmp(a, b, sizeof a));
+    CHECK(1 == card()->clock_step_downs && 6000000 >= card()->baud_rate);
+    CHECK(3 == card()->stats.transfer_retries - retries);
+}
+
+static DRESULT results[4];
+static int n_results;
+
+static void record(DRESULT dr, void *ctx)
+{
+    (void)ctx;
+    results[n_results++] = dr;
+}
+
+static void test_faults(void)
+{
+    static uint8_t a[64 * 512], b[512];
+    sd_emu_stats_t *st = sd_emu_stats();
+    CHECK(sd_emu_open_ram(SECTORS));
+    CHECK(0 == (disk_initialize(0) & STA_NOINIT));
+    for (int i = 0; i < (int)sizeof a; i++) a[i] = pattern(i + 3);
+
+    // Um comando sem resposta é mandado de novo. O cartão conta comandos
+    // desde a abertura: o próximo é o CMD17
+    memset(&card()->stats, 0, sizeof card()->stats);
+    sd_emu_faults()->drop_cmd_at = commands_seen() + 1;
+    CHECK(RES_OK == disk_read(0, b, 1, 1));
+    CHECK(1 == st->dropped_commands && 1 == card()->stats.command_retries);
+    CHECK(0 == memcmp(b, sd_emu_data() + 512, 512));
+    sd_emu_faults()->drop_cmd_at = 0;
+
+    // Um bloco lido com CRC errado é lido de novo. O cartão conta blocos
+    // desde a abertura
+    sd_emu_faults()->fail_read_at = st->blocks_read + 1;
+    reset_counters();
+    CHECK(RES_OK == disk_read(0, b, 0, 1));
+    CHECK(1 == st->read_crc_faults && 2 == st->blocks_read);
+    CHECK(1 == card()->stats.transfer_retries && 1 == card()->stats.crc_errors);
+    CHECK(0 == memcmp(b, sd_emu_data(), 512));
+
+    // Um bloco recusado: a escrita falha e o CMD13 seguinte vê o erro
+    reset_counters();
+    sd_emu_faults()->fail_write_at = 1;  // Nada foi escrito desde a abertura
+    CHECK(RES_ERROR == disk_write(0, a, 50, 1));
+    CHECK(1 == st->write_errors && 0 == st->blocks_written);
+    CHECK(0 == sd_emu_data()[50 * 512]);
+    CHECK(RES_OK == disk_read(0, b, 50, 1));
+
+    // O segundo bloco de um CMD25 assíncrono recusado: o callback recebe o
+    // erro, e o bloco não é repetido
+    reset_counters();
+    sd_emu_faults()->fail_write_at = 3;  // Os blocos recusados também contam
+    n_results = 0;
+    CHECK(RES_OK == disk_write_async(0, a, 60, 4, record, NULL));
+    disk_async_flush();
+    CHECK(1 == n_results && RES_ERROR == results[0]);
+    CHECK(1 == st->write_errors && 1 == card()->stats.multi_block_writes);
+    CHECK(0 == memcmp(a, sd_emu_data() + 60 * 512, 512));
+    sd_emu_faults()->fail_write_at = 0;
+    CHECK(same_commands());
+
+    // Uma escrita assíncrona longa chega inteira à imagem
+    reset_counters();
+    CHECK(RES_OK == disk_write_async(0, a, 1000, 64, NULL, NULL));
+    disk_async_poll();
+    CHECK(1 == disk_async_pending());
+    disk_async_flush();
+    CHECK(0 == disk_async_pending());
+    CHECK(64 == st->blocks_written && 1 == st->commands[25]);
+    CHECK(0 == memcmp(a, sd_emu_data() + 1000 * 512, sizeof a));
+    CHECK(RES_OK == disk_ioctl(0, CTRL_SYNC, NULL));
+    CHECK(same_commands());
+    CHECK(wire_adds_up());
+
+    // Cartão removido: sem resposta
+    sd_emu_close();
+    CHECK(RES_OK != disk_read(0, b, 0, 1));
+}
+
+int main(void)
+{
+    test_init();
+    test_files();
+    test_wire();
+    test_clock();
+    test_faults();
+    return host_test_result("test_emu");
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,232 @@
+/* test_f_lines.c
+O leitor de linhas em blocos (f_lines.c) sobre o cartão simulado por
+imagem (sd_image.c), leve o bastante para que a CPU medida seja a do FatFs
+e dos leitores: as linhas de um CSV de vários MB saem iguais às do f_gets,
+com buffers de tamanhos diferentes, e os casos de borda (linha maior que o
+buffer, arquivo vazio, sem '\n' no fim, erro de leitura). Depois, linhas
+por segundo dos dois, como o comando 'linebench'.
+
+Argumento: o tamanho do CSV em MB (padrão 4).
+*/
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "pico/stdlib.h"
+#include "ff.h"
+#include "diskio.h"
+#include "f_lines.h"
+#include "f_util.h"
+#include "host_test.h"
+#include "hw_config.h"
+#include "sd_image.h"
+
+#define SECTORS (64ull * 1024 * 1024 / 512)  // 64 MiB
+#define LINE_READ_SIZE 4096                  // O do datalogger.c
+
+static FATFS fs;
+
+// A linha i do CSV, no formato do datalogger: tempo e seis eixos
+static int csv_line(char *s, uint32_t i)
+{
+    uint32_t h = i * 2654435761u;
+    return sprintf(s, "%lu,%d,%d,%d,%d,%d,%d\n", (unsigned long)i * 1000,
+                   (int16_t)h, (int16_t)(h >> 7), (int16_t)(h >> 13),
+                   (int16_t)(h >> 3) / 16, (int16_t)(h >> 9) / 256, (int16_t)(h >> 17) / 4096);
+}
+
+static uint32_t write_csv(const char *path, uint32_t bytes)
+{
+    FIL fil;
+    static char buf[32 * 1024];
+    uint32_t lines = 0, size = 0;
+    CHECK_FR(f_open(&fil, path, FA_CREATE_ALWAYS | FA_WRITE));
+    while (size < bytes) {
+        size_t n = 0;
+        while (n < sizeof buf - 64 && size + n < bytes) n += csv_line(buf + n, lines++);
+        UINT bw;
+        CHECK_FR(f_write(&fil, buf, n, &bw));
+        size += bw;
+    }
+    CHECK_FR(f_close(&fil));
+    return lines;
+}
+
+static void write_text(const char *path, const char *text, size_t len)
+{
+    FIL fil;
+    UINT bw;
+    CHECK_FR(f_open(&fil, path, FA_CREATE_ALWAYS | FA_WRITE));
+    CHECK_FR(f_write(&fil, text, len, &bw));
+    CHECK_FR(f_close(&fil));
+}
+
+// Todas as linhas do CSV, em ordem, com um buffer de size bytes
+static bool check_csv(const char *path, uint32_t lines, size_t size)
+{
+    FIL fil;
+    static char buf[64 * 1024] __attribute__((aligned(4)));
+    char expect[64];
+    f_lines_t lr;
+    size_t n;
+    uint32_t i = 0;
+    bool ok = FR_OK == f_open(&fil, path, FA_READ);
+    f_lines_init(&lr, &fil, buf, size);
+    for (const char *s; ok && (s = f_lines_next(&lr, &n)); i++) {
+        int len = csv_line(expect, i);
+        ok = n == (size_t)len && 0 == memcmp(s, expect, n);
+    }
+    f_close(&fil);
+    return ok && FR_OK == lr.fr && i == lines;
+}
+
+// f_lines e f_gets devolvem as mesmas linhas
+static bool same_as_f_gets(const char *path)
+{
+    FIL a, b;
+    static char buf[LINE_READ_SIZE] __attribute__((aligned(4)));
+    char line[256];
+    f_lines_t lr;
+    size_t n;
+    bool ok = FR_OK == f_open(&a, path, FA_READ) && FR_OK == f_open(&b, path, FA_READ);
+    f_lines_init(&lr, &a, buf, sizeof buf);
+    while (ok) {
+        const char *s = f_lines_next(&lr, &n);
+        const char *g = f_gets(line, sizeof line, &b);
+        if (!s || !g) {
+            ok = !s && !g;
+            break;
+        }
+        ok = strlen(g) == n && 0 == memcmp(s, g, n);
+    }
+    f_close(&a);
+    f_close(&b);
+    return ok;
+}
+
+static void test_edges(void)
+{
+    static char buf[1024] __attribute__((aligned(4)));
+    f_lines_t lr;
+    FIL fil;
+    size_t n;
+    const char *s;
+
+    write_text("0:/curto.txt", "a\nbb\n\nccc", 9);
+    CHECK_FR(f_open(&fil, "0:/curto.txt", FA_READ));
+    f_lines_init(&lr, &fil, buf, 512);
+    CHECK((s = f_lines_next(&lr, &n)) && 2 == n && 0 == memcmp(s, "a\n", 2));
+    CHECK((s = f_lines_next(&lr, &n)) && 3 == n && 0 == memcmp(s, "bb\n", 3));
+    CHECK((s = f_lines_next(&lr, &n)) && 1 == n && '\n' == s[0]);
+    CHECK((s = f_lines_next(&lr, &n)) && 3 == n && 0 == memcmp(s, "ccc", 3));  // Sem '\n'
+    CHECK(!f_lines_next(&lr, &n) && FR_OK == lr.fr);
+    CHECK_FR(f_close(&fil));
+
+    // Maior que o buffer: em pedaços do tamanho dele; só o último tem '\n'
+    static char longline[3001];
+    memset(longline, 'x', 3000);
+    longline[3000] = '\n';
+    write_text("0:/longa.txt", longline, sizeof longline);
+    CHECK_FR(f_open(&fil, "0:/longa.txt", FA_READ));
+    f_lines_init(&lr, &fil, buf, sizeof buf);
+    CHECK((s = f_lines_next(&lr, &n)) && 1024 == n && 'x' == s[1023]);
+    CHECK((s = f_lines_next(&lr, &n)) && 1024 == n && 'x' == s[1023]);
+    CHECK((s = f_lines_next(&lr, &n)) && 953 == n && '\n' == s[952]);
+    CHECK(!f_lines_next(&lr, &n));
+    CHECK_FR(f_close(&fil));
+
+    write_text("0:/vazio.txt", "", 0);
+    CHECK_FR(f_open(&fil, "0:/vazio.txt", FA_READ));
+    f_lines_init(&lr, &fil, buf, sizeof buf);
+    CHECK(!f_lines_next(&lr, &n) && FR_OK == lr.fr);
+    CHECK_FR(f_close(&fil));
+}
+
+static double now_s(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* Conta as linhas como o 'linebench': method 0 é o f_gets, 1 o leitor em
+blocos. Mede o relógio virtual (o modelo de latência do cartão) e a CPU
+da máquina (FatFs, conversão de código, busca). */
+static uint32_t count_lines(const char *path, int method, FSIZE_t size)
+{
+    static FIL fil;
+    static char rd[LINE_READ_SIZE] __attribute__((aligned(4)));
+    uint32_t lines = 0;
+    CHECK_FR(f_open(&fil, path, FA_READ));
+    sd_card_t *pSD = sd_get_by_num(0);
+    uint32_t cmds17 = pSD->stats.commands[17], cmds18 = pSD->stats.commands[18];
+    uint64_t t0 = host_time_ns();
+    double c0 = now_s();
+    if (0 == method) {
+        char buf[256];
+        while (f_gets(buf, sizeof buf, &fil)) lines++;
+    } else {
+        f_lines_t lr;
+        size_t n;
+        f_lines_init(&lr, &fil, rd, sizeof rd);
+        while (f_lines_next(&lr, &n)) lines++;
+    }
+    double cpu = now_s() - c0;
+    double virt = (host_time_ns() - t0) * 1e-9;
+    CHECK_FR(f_close(&fil));
+    static const char *names[] = {"f_gets", "leitor em blocos"};
+    printf("  %-17s %8lu linhas  cartão %7.3f s %9.0f linhas/s %6.0f KB/s  CPU %6.3f s %10.0f linhas/s"
+           "  CMD17 %lu CMD18 %lu\n",
+           names[method], (unsigned long)lines, virt, lines / virt, size / 1024.0 / virt, cpu,
+           lines / cpu, (unsigned long)(pSD->stats.commands[17] - cmds17),
+           (unsigned long)(pSD->stats.commands[18] - cmds18));
+    return lines;
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t mb = argc > 1 ? strtoul(argv[1], NULL, 0) : 4;
+    static uint8_t work[FF_MAX_SS];
+    MKFS_PARM opt = {FM_ANY, 0, 0, 0, 0};
+    CHECK(sd_image_open_ram(SECTORS));
+    CHECK_FR(f_mkfs("0:", &opt, work, sizeof work));
+    CHECK_FR(f_mount(&fs, "0:", 1));
+
+    test_edges();
+
+    uint32_t lines = write_csv("0:/dados.csv", mb * 1024 * 1024);
+    CHECK(check_csv("0:/dados.csv", lines, LINE_READ_SIZE));
+    CHECK(check_csv("0:/dados.csv", lines, 512));
+    CHECK(check_csv("0:/dados.csv", lines, 1000));  // Fora de setor
+    CHECK(check_csv("0:/dados.csv", lines, 64 * 1024));
+    CHECK(same_as_f_gets("0:/dados.csv"));
+
+    FILINFO fno;
+    CHECK_FR(f_stat("0:/dados.csv", &fno));
+    printf("dados.csv: %lu bytes, %lu linhas\n", (unsigned long)fno.fsize, (unsigned long)lines);
+    CHECK(lines == count_lines("0:/dados.csv", 0, fno.fsize));
+    CHECK(lines == count_lines("0:/dados.csv", 1, fno.fsize));
+
+    // Erro de leitura: f_lines_next devolve NULL e guarda o erro
+    {
+        static char buf[LINE_READ_SIZE] __attribute__((aligned(4)));
+        FIL fil;
+        f_lines_t lr;
+        size_t n;
+        uint32_t got = 0;
+        CHECK_FR(f_open(&fil, "0:/dados.csv", FA_READ));
+        f_lines_init(&lr, &fil, buf, sizeof buf);
+        for (int i = 0; i < 1000; i++) CHECK(f_lines_next(&lr, &n));
+        sd_image_faults()->fail_read_every = 1;
+        while (f_lines_next(&lr, &n)) got++;
+        CHECK(FR_OK != lr.fr);
+        CHECK(got < lines);
+        sd_image_faults()->fail_read_every = 0;
+        f_close(&fil);
+    }
+    f_unmount("0:");
+    sd_image_close();
+    return host_test_result("test_f_lines");
+}
+
+/* [] END OF FILE */
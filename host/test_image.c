@@ -0,0 +1,238 @@
+/* test_image.c
+O FatFs, a fila assíncrona do glue.c e o f_stream sobre o cartão simulado
+por imagem (sd_image.c): formata, grava e confere arquivos, propaga falhas
+injetadas e confere o modelo de latência. O argumento é o caminho de um
+.img temporário para o teste de persistência.
+*/
+#include <stdlib.h>
+#include <string.h>
+
+#include "pico/stdlib.h"
+#include "ff.h"
+#include "diskio.h"
+#include "disk_async.h"
+#include "f_stream.h"
+#include "f_util.h"
+#include "ff.h"
+#include "host_test.h"
+#include "hw_config.h"
+#include "sd_image.h"
+
+#define SECTORS (64ull * 1024 * 1024 / 512)  // 64 MiB
+#define FILE_BYTES (3 * 1024 * 1024 + 777)
+
+static uint8_t pattern(uint32_t i) { return (uint8_t)(i * 2654435761u >> 24); }
+
+static void write_file(const char *path, uint32_t bytes)
+{
+    FIL fil;
+    static uint8_t buf[16 * 1024];
+    CHECK_FR(f_open(&fil, path, FA_CREATE_ALWAYS | FA_WRITE));
+    for (uint32_t off = 0; off < bytes;) {
+        UINT n = bytes - off < sizeof buf ? bytes - off : sizeof buf, bw;
+        for (UINT i = 0; i < n; i++) buf[i] = pattern(off + i);
+        CHECK_FR(f_write(&fil, buf, n, &bw));
+        CHECK(bw == n);
+        off += n;
+    }
+    CHECK_FR(f_close(&fil));
+}
+
+static bool verify_file(const char *path, uint32_t bytes)
+{
+    FIL fil;
+    static uint8_t buf[5000];  // Fora de setor, de propósito
+    bool ok = FR_OK == f_open(&fil, path, FA_READ) && f_size(&fil) == bytes;
+    for (uint32_t off = 0; ok && off < bytes;) {
+        UINT br;
+        ok = FR_OK == f_read(&fil, buf, sizeof buf, &br) && br;
+        for (UINT i = 0; ok && i < br; i++) ok = buf[i] == pattern(off + i);
+        off += br;
+    }
+    f_close(&fil);
+    return ok;
+}
+
+typedef struct {
+    uint32_t off;
+    bool ok;
+} stream_check_t;
+
+static bool stream_sink(const void *data, size_t len, void *ctx)
+{
+    stream_check_t *c = ctx;
+    const uint8_t *p = data;
+    for (size_t i = 0; i < len; i++) {
+        if (p[i] != pattern(c->off + i)) c->ok = false;
+    }
+    c->off += len;
+    return true;
+}
+
+static void test_files(void)
+{
+    static FATFS fs;
+    static uint8_t work[FF_MAX_SS];
+    CHECK(sd_image_open_ram(SECTORS));
+    MKFS_PARM opt = {FM_ANY, 0, 0, 0, 0};
+    CHECK_FR(f_mkfs("0:", &opt, work, sizeof work));
+    CHECK_FR(f_mount(&fs, "0:", 1));
+    write_file("0:/dados.bin", FILE_BYTES);
+    CHECK(verify_file("0:/dados.bin", FILE_BYTES));
+
+    // f_stream: leituras CMD18 de um cluster pela fila assíncrona
+    FIL fil;
+    static uint8_t buf[2 * 64 * 1024];
+    stream_check_t c = {0, true};
+    uint32_t async_before = sd_get_by_num(0)->stats.async_reads;
+    CHECK_FR(f_open(&fil, "0:/dados.bin", FA_READ));
+    CHECK_FR(f_stream(&fil, buf, sizeof buf, stream_sink, &c));
+    CHECK_FR(f_close(&fil));
+    CHECK(c.ok && FILE_BYTES == c.off);
+    CHECK(sd_get_by_num(0)->stats.async_reads > async_before);
+
+    // Os setores do arquivo estão mesmo na imagem
+    DWORD clst = 0;
+    CHECK_FR(f_open(&fil, "0:/dados.bin", FA_READ));
+    clst = fil.obj.sclust;
+    LBA_t lba = fs.database + (LBA_t)(clst - 2) * fs.csize;
+    CHECK(0 == memcmp(sd_image_data() + lba * 512, (uint8_t[]){pattern(0), pattern(1), pattern(2)}, 3));
+    CHECK_FR(f_close(&fil));
+    CHECK_FR(f_unmount("0:"));
+    CHECK(0 == disk_async_pending());
+}
+
+static DRESULT results[4];
+static int n_results;
+
+static void record(DRESULT dr, void *ctx)
+{
+    (void)ctx;
+    results[n_results++] = dr;
+}
+
+static void test_faults(void)
+{
+    static uint8_t a[4 * 512], b[512];
+    CHECK(sd_image_open_ram(1024));
+    CHECK(0 == (disk_initialize(0) & STA_NOINIT));
+    memset(a, 0xA5, sizeof a);
+
+    // A segunda escrita da fila falha: o callback recebe o erro, e a imagem
+    // fica como estava
+    sd_image_faults()->fail_write_at = 2;
+    n_results = 0;
+    CHECK(RES_OK == disk_write_async(0, a, 10, 4, record, NULL));
+    CHECK(RES_OK == disk_write_async(0, a, 20, 1, record, NULL));
+    CHECK(RES_OK == disk_read(0, b, 0, 1));
+    CHECK(2 == n_results && RES_OK == results[0] && RES_ERROR == results[1]);
+    CHECK(0xA5 == sd_image_data()[10 * 512] && 0 == sd_image_data()[20 * 512]);
+    CHECK(1 == sd_image_stats()->write_errors);
+    // Quem vem depois não herda o erro
+    CHECK(RES_OK == disk_read(0, b, 10, 1) && 0xA5 == b[0]);
+    CHECK(RES_OK == disk_ioctl(0, CTRL_SYNC, NULL));
+
+    // Escrita síncrona e leitura que falham
+    sd_image_faults()->fail_write_every = 1;
+    CHECK(RES_ERROR == disk_write(0, a, 30, 1));
+    sd_image_faults()->fail_write_every = 0;
+    sd_image_faults()->fail_read_every = 1;
+    sd_image_faults()->read_error = SD_BLOCK_DEVICE_ERROR_NO_RESPONSE;
+    CHECK(RES_NOTRDY == disk_read(0, b, 10, 1));
+    sd_image_faults()->fail_read_every = 0;
+
+    // Fora do cartão
+    CHECK(RES_PARERR == disk_read(0, b, 1024, 1));
+
+    // Cartão removido
+    sd_image_close();
+    CHECK(disk_status(0) & STA_NODISK);
+    CHECK(RES_NOTRDY == disk_read(0, b, 0, 1));
+}
+
+static void test_latency(void)
+{
+    static uint8_t a[64 * 512];
+    CHECK(sd_image_open_ram(65536));
+    sd_image_model_t *m = sd_image_model();
+    m->card.spike_every = 0;
+    CHECK(0 == (disk_initialize(0) & STA_NOINIT));
+
+    // Leitura: comando, NAC e os bytes de cada bloco, mais o CMD12
+    uint64_t t0 = host_time_ns();
+    CHECK(RES_OK == disk_read(0, a, 0, 8));
+    uint64_t wire = 515ull * 8 * 1000000000ull / m->spi_hz;
+    uint64_t expect = 2000ull * m->cmd_us + 8 * (1000ull * m->card.read_access_us + wire);
+    CHECK(host_time_ns() - t0 == expect);
+
+    // Um CMD24 volta sem esperar o ocupado; o próximo comando espera
+    t0 = host_time_ns();
+    CHECK(RES_OK == disk_write(0, a, 100, 1));
+    uint64_t t1 = host_time_ns();
+    CHECK(t1 - t0 < 1000ull * m->card.write_busy_us);
+    CHECK(RES_OK == disk_write(0, a, 101, 1));
+    CHECK(host_time_ns() - t1 >= 1000ull * (m->card.write_busy_us + m->card.write_cmd_busy_us));
+    CHECK(sd_image_stats()->wait_busy_us > 0);
+
+    // Um CMD25 de 64 blocos é mais rápido por bloco que CMD24 isolados,
+    // e mais lento que o barramento
+    CHECK(RES_OK == disk_ioctl(0, CTRL_SYNC, NULL));
+    t0 = host_time_ns();
+    CHECK(RES_OK == disk_write(0, a, 128, 64));
+    uint64_t multi = host_time_ns() - t0;
+    CHECK(multi > 64 * wire);
+    t0 = host_time_ns();
+    for (int i = 0; i < 16; i++) CHECK(RES_OK == disk_write(0, a, 256 + i, 1));
+    CHECK(RES_OK == disk_ioctl(0, CTRL_SYNC, NULL));
+    CHECK((host_time_ns() - t0) / 16 > multi / 64);
+
+    // Mudar de AU custa au_busy_us a mais
+    CHECK(RES_OK == disk_ioctl(0, CTRL_SYNC, NULL));
+    t0 = host_time_ns();
+    CHECK(RES_OK == disk_write(0, a, 512, 2));
+    uint64_t same_au = host_time_ns() - t0;
+    t0 = host_time_ns();
+    CHECK(RES_OK == disk_write(0, a, m->card.au_sectors + 512, 2));
+    CHECK(host_time_ns() - t0 == same_au + 1000ull * m->card.au_busy_us);
+
+    // As escritas assíncronas só terminam quando o relógio chega ao fim
+    CHECK(RES_OK == disk_write_async(0, a, 1024, 64, NULL, NULL));
+    disk_async_poll();
+    CHECK(1 == disk_async_pending());
+    disk_async_flush();
+    CHECK(0 == disk_async_pending());
+    sd_image_close();
+}
+
+static void test_file_image(const char *path)
+{
+    static FATFS fs;
+    static uint8_t work[FF_MAX_SS];
+    remove(path);
+    CHECK(sd_image_open_file(path, SECTORS));
+    MKFS_PARM opt = {FM_ANY, 0, 0, 0, 0};
+    CHECK_FR(f_mkfs("0:", &opt, work, sizeof work));
+    CHECK_FR(f_mount(&fs, "0:", 1));
+    write_file("0:/persiste.bin", 100000);
+    CHECK_FR(f_unmount("0:"));
+    sd_image_close();
+
+    // Reaberta com o tamanho do arquivo
+    CHECK(sd_image_open_file(path, 0));
+    CHECK_FR(f_mount(&fs, "0:", 1));
+    CHECK(verify_file("0:/persiste.bin", 100000));
+    CHECK_FR(f_unmount("0:"));
+    sd_image_close();
+    remove(path);
+}
+
+int main(int argc, char **argv)
+{
+    test_files();
+    test_faults();
+    test_latency();
+    test_file_image(argc > 1 ? argv[1] : "test_image.img");
+    return host_test_result("test_image");
+}
+
+/* [] END OF FILE */
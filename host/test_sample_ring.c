@@ -0,0 +1,213 @@
+/* test_sample_ring.c
+O anel SPSC do sample_ring.h com um produtor e um consumidor em duas
+threads de verdade: a ordem e o conteúdo de cada amostra, os blocos
+contíguos sem atravessar o fim do vetor, a contagem de descartes e a marca
+máxima. Antes, os casos de borda numa thread só.
+*/
+#include <pthread.h>
+#include <sched.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "host_test.h"
+#include "sample_ring.h"
+
+#define CAPACITY 256  // Pequeno, para o anel encher e dar a volta muitas vezes
+#define SAMPLES 2000000u
+
+static sample_ring_t ring;
+static imu_sample_t ring_buf[CAPACITY];
+
+// O conteúdo de uma amostra depende só do seu número de sequência
+static void fill(imu_sample_t *s, uint32_t seq)
+{
+    s->timestamp_us = seq;
+    for (int i = 0; i < 3; i++) {
+        s->accel[i] = (int16_t)(seq * (i + 3));
+        s->gyro[i] = (int16_t)(seq ^ (0x5A5A << i));
+    }
+}
+
+static bool intact(const imu_sample_t *s)
+{
+    imu_sample_t e;
+    fill(&e, s->timestamp_us);
+    return 0 == memcmp(s, &e, sizeof e);
+}
+
+static void test_single_thread(void)
+{
+    static imu_sample_t buf[8];
+    imu_sample_t s;
+    CHECK(!sample_ring_init(&ring, buf, 0));
+    CHECK(!sample_ring_init(&ring, buf, 6));
+    CHECK(sample_ring_init(&ring, buf, 8));
+    CHECK(8 == sample_ring_capacity(&ring));
+
+    // head e tail em linhas de cache distintas
+    CHECK(offsetof(sample_ring_t, tail) - offsetof(sample_ring_t, head) >= SAMPLE_RING_ALIGN);
+
+    // Cheio: a nona é descartada e contada
+    for (uint32_t i = 0; i < 8; i++) {
+        fill(&s, i);
+        CHECK(sample_ring_push(&ring, &s));
+    }
+    fill(&s, 8);
+    CHECK(!sample_ring_push(&ring, &s));
+    CHECK(1 == sample_ring_overflows(&ring));
+    CHECK(8 == sample_ring_high_watermark(&ring) && 8 == sample_ring_total(&ring));
+
+    // Os blocos param no fim do vetor
+    uint32_t n = 5;
+    const imu_sample_t *p = sample_ring_peek(&ring, &n);
+    CHECK(5 == n && 0 == p[0].timestamp_us && 4 == p[4].timestamp_us);
+    sample_ring_release(&ring, 5);
+    n = 8;
+    imu_sample_t *w = sample_ring_reserve(&ring, &n);
+    CHECK(5 == n && w == &buf[0]);
+    for (uint32_t i = 0; i < 5; i++) fill(&w[i], 8 + i);
+    sample_ring_commit(&ring, 5);
+    n = 8;
+    p = sample_ring_peek(&ring, &n);
+    CHECK(3 == n && 5 == p[0].timestamp_us);  // Até o fim do vetor
+    sample_ring_release(&ring, n);
+    n = 8;
+    p = sample_ring_peek(&ring, &n);
+    CHECK(5 == n && 8 == p[0].timestamp_us && &buf[0] == p);
+    sample_ring_release(&ring, n);
+    CHECK(0 == sample_ring_count(&ring));
+
+    // A marca máxima recomeça da ocupação atual
+    sample_ring_reset_high_watermark(&ring);
+    CHECK(0 == sample_ring_high_watermark(&ring));
+    fill(&s, 13);
+    CHECK(sample_ring_push(&ring, &s));
+    CHECK(1 == sample_ring_high_watermark(&ring));
+
+    sample_ring_reset(&ring);
+    CHECK(0 == sample_ring_count(&ring) && 0 == sample_ring_overflows(&ring));
+}
+
+typedef struct {
+    bool drop;       // Como a interrupção: com o anel cheio, descarta
+    uint32_t seed;
+} producer_arg_t;
+
+static volatile bool producer_done;
+
+static uint32_t next_rand(uint32_t *x)
+{
+    *x ^= *x << 13;
+    *x ^= *x >> 17;
+    *x ^= *x << 5;
+    return *x;
+}
+
+// Publica SAMPLES amostras em blocos de tamanho aleatório
+static void *producer(void *arg)
+{
+    producer_arg_t *a = arg;
+    uint32_t rnd = a->seed;
+    for (uint32_t seq = 0; seq < SAMPLES;) {
+        uint32_t want = 1 + next_rand(&rnd) % SAMPLES_PER_SECTOR;
+        if (want > SAMPLES - seq) want = SAMPLES - seq;
+        uint32_t n = want;
+        imu_sample_t *w = sample_ring_reserve(&ring, &n);
+        for (uint32_t i = 0; i < n; i++) fill(&w[i], seq + i);
+        sample_ring_commit(&ring, n);
+        seq += n;
+        if (a->drop) {
+            // Sem espaço: o resto do bloco se perde, como no ISR
+            if (n < want) sample_ring_overflow(&ring, want - n);
+            seq += want - n;
+            // O período de amostragem, com jitter: às vezes o consumidor
+            // acompanha, às vezes fica para trás
+            for (volatile uint32_t k = next_rand(&rnd) % 2048; k; k--) {
+            }
+        } else if (!n) {
+            sched_yield();
+        }
+    }
+    producer_done = true;
+    return NULL;
+}
+
+typedef struct {
+    uint32_t received;
+    uint32_t gaps;     // Amostras que faltaram na sequência
+    uint32_t bad;      // Fora de ordem ou com o conteúdo errado
+    uint32_t max_block;
+} consumer_result_t;
+
+// Drena em blocos de até um setor, como o gravador
+static void consume(consumer_result_t *c)
+{
+    uint32_t expect = 0;
+    memset(c, 0, sizeof *c);
+    for (;;) {
+        bool done = producer_done;
+        uint32_t n = SAMPLES_PER_SECTOR;
+        const imu_sample_t *p = sample_ring_peek(&ring, &n);
+        if (!n) {
+            if (done) break;  // done lido antes do peek: nada mais vem
+            sched_yield();
+            continue;
+        }
+        if (n > c->max_block) c->max_block = n;
+        for (uint32_t i = 0; i < n; i++) {
+            uint32_t seq = p[i].timestamp_us;
+            if (seq < expect || !intact(&p[i])) c->bad++;
+            else c->gaps += seq - expect;
+            expect = seq + 1;
+        }
+        c->received += n;
+        sample_ring_release(&ring, n);
+    }
+    c->gaps += SAMPLES - expect;
+}
+
+static void run_threads(bool drop, consumer_result_t *c)
+{
+    pthread_t t;
+    producer_arg_t a = {drop, 2463534242u};
+    CHECK(sample_ring_init(&ring, ring_buf, CAPACITY));
+    producer_done = false;
+    CHECK(0 == pthread_create(&t, NULL, producer, &a));
+    consume(c);
+    CHECK(0 == pthread_join(t, NULL));
+}
+
+static void test_threads(void)
+{
+    consumer_result_t c;
+
+    // Produtor que espera: tudo chega, em ordem e intacto
+    run_threads(false, &c);
+    CHECK(SAMPLES == c.received && 0 == c.gaps && 0 == c.bad);
+    CHECK(0 == sample_ring_overflows(&ring));
+    CHECK(SAMPLES == sample_ring_total(&ring));
+    CHECK(sample_ring_high_watermark(&ring) <= CAPACITY);
+    CHECK(c.max_block <= SAMPLES_PER_SECTOR);
+    printf("espera: %u amostras, marca máxima %u de %u\n", c.received,
+           sample_ring_high_watermark(&ring), CAPACITY);
+
+    // Produtor que descarta: cada amostra chega ou é contada como perdida
+    run_threads(true, &c);
+    CHECK(0 == c.bad);
+    CHECK(c.gaps == sample_ring_overflows(&ring));
+    CHECK(SAMPLES == c.received + c.gaps);
+    CHECK(c.received > 0);
+    CHECK(c.received == sample_ring_total(&ring));
+    CHECK(sample_ring_high_watermark(&ring) <= CAPACITY);
+    printf("descarte: %u amostras, %u perdidas, marca máxima %u de %u\n", c.received,
+           sample_ring_overflows(&ring), sample_ring_high_watermark(&ring), CAPACITY);
+}
+
+int main(void)
+{
+    test_single_thread();
+    test_threads();
+    return host_test_result("test_sample_ring");
+}
+
+/* [] END OF FILE */
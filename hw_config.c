@@ -35,9 +35,10 @@ static spi_t spis[] = {  // One for each SPI.
         .mosi_gpio = 19,
         .sck_gpio = 18,
 
-        // .baud_rate = 1000 * 1000
-        .baud_rate = 1000 * 1000
-        // .baud_rate = 25 * 1000 * 1000 // Actual frequency: 20833333.
+        // Ceiling for SCK: at mount the driver tries 25, 20, 12.5, 6 and
+        // 1 MHz, up to this value, and keeps the fastest that reads back
+        // cleanly. It steps down on its own after repeated CRC errors.
+        .baud_rate = 25 * 1000 * 1000  // Actual frequency: 20833333.
     }};
 
 // Hardware Configuration of the SD Card "objects"
@@ -48,8 +49,11 @@ static sd_card_t sd_cards[] = {  // One for each SD card
         .ss_gpio = 17,    // The SPI slave select GPIO for this SD card
         .use_card_detect = false,
         .card_detect_gpio = 22,  // Card detect
-        .card_detected_true = -1  // What the GPIO read returns when a card is
-                                 // present.
+        .card_detected_true = -1,  // What the GPIO read returns when a card is
+                                  // present.
+        // Check the card status (CMD13) at CTRL_SYNC and unmount instead of
+        // after every write; rejected writes are still checked at once
+        .status_check = SD_STATUS_CHECK_ON_SYNC
     }};
 
 /* ********************************************************************** */
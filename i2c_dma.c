@@ -0,0 +1,241 @@
+/* i2c_dma.c
+Transferências I2C assíncronas por DMA. Ver i2c_dma.h.
+*/
+#include <assert.h>
+#include <stdbool.h>
+//
+#include "pico/stdlib.h"
+#include "hardware/dma.h"
+#include "hardware/i2c.h"
+#include "hardware/irq.h"
+//
+#include "i2c_dma.h"
+#include "trace.h"
+
+static i2c_dma_t *instances[2]; // Um por bloco I2C
+
+static void dma_irq_set_enabled(const i2c_dma_t *d, bool enabled)
+{
+    if (d->DMA_IRQ_num == DMA_IRQ_0)
+        dma_channel_set_irq0_enabled(d->rx_dma, enabled);
+    else
+        dma_channel_set_irq1_enabled(d->rx_dma, enabled);
+}
+
+static io_rw_32 *dma_ints(const i2c_dma_t *d)
+{
+    return d->DMA_IRQ_num == DMA_IRQ_0 ? &dma_hw->ints0 : &dma_hw->ints1;
+}
+
+// Encerra a transferência atual e avisa o dono
+static void i2c_dma_finish(i2c_dma_t *d, bool ok)
+{
+    i2c_get_hw(d->i2c)->intr_mask = 0; // TX_ABRT volta a ser das funções bloqueantes do SDK
+    if (!d->write)
+        TRACE_END(TRACE_EV_I2C_READ);
+    d->ok = ok;
+    if (!ok)
+        d->aborts++;
+    i2c_dma_callback_t callback = d->callback;
+    void *ctx = d->ctx;
+    d->busy = false; // Antes do callback, que pode enviar a próxima transferência
+    if (callback)
+        callback(ok, ctx);
+}
+
+// Cancela os dois canais e descarta o que sobrou na FIFO de RX
+static void i2c_dma_cancel(i2c_dma_t *d)
+{
+    // RP2040-E13: o abort pode gerar uma interrupção de conclusão espúria
+    dma_irq_set_enabled(d, false);
+    dma_channel_abort(d->tx_dma);
+    dma_channel_abort(d->rx_dma);
+    *dma_ints(d) = 1u << d->rx_dma;
+    dma_irq_set_enabled(d, true);
+
+    i2c_hw_t *hw = i2c_get_hw(d->i2c);
+    while (hw->rxflr)
+        (void)hw->data_cmd;
+}
+
+static void __not_in_flash_func(in_dma_irq_handler)(uint DMA_IRQ_num)
+{
+    for (size_t i = 0; i < count_of(instances); i++)
+    {
+        i2c_dma_t *d = instances[i];
+        if (!d || d->DMA_IRQ_num != DMA_IRQ_num)
+            continue;
+        io_rw_32 *ints = dma_ints(d);
+        if (*ints & (1u << d->rx_dma))
+        {
+            *ints = 1u << d->rx_dma; // Limpa
+            if (d->busy)
+                i2c_dma_finish(d, true);
+        }
+    }
+}
+static void __not_in_flash_func(dma_irq_handler_0)() { in_dma_irq_handler(DMA_IRQ_0); }
+static void __not_in_flash_func(dma_irq_handler_1)() { in_dma_irq_handler(DMA_IRQ_1); }
+
+// NACK do escravo: o bloco I2C esvazia a FIFO de TX e gera TX_ABRT.
+// Numa escrita, STOP_DET sem TX_ABRT é o fim normal.
+static void __not_in_flash_func(in_abort_irq_handler)(uint index)
+{
+    i2c_dma_t *d = instances[index];
+    if (!d)
+        return;
+    i2c_hw_t *hw = i2c_get_hw(d->i2c);
+    uint32_t stat = hw->intr_stat;
+    if (stat & I2C_IC_INTR_STAT_R_TX_ABRT_BITS)
+    {
+        (void)hw->clr_tx_abrt;
+        (void)hw->clr_stop_det; // O abort também termina com STOP
+        if (d->busy)
+        {
+            i2c_dma_cancel(d);
+            i2c_dma_finish(d, false);
+        }
+    }
+    else if (stat & I2C_IC_INTR_STAT_R_STOP_DET_BITS)
+    {
+        (void)hw->clr_stop_det;
+        if (d->busy && d->write)
+            i2c_dma_finish(d, true);
+    }
+}
+static void __not_in_flash_func(abort_irq_handler_0)() { in_abort_irq_handler(0); }
+static void __not_in_flash_func(abort_irq_handler_1)() { in_abort_irq_handler(1); }
+
+// Prepara os canais de DMA para um I2C já inicializado com i2c_init().
+// As interrupções ficam no núcleo que chamar esta função.
+bool i2c_dma_init(i2c_dma_t *d, i2c_inst_t *i2c, uint DMA_IRQ_num)
+{
+    uint index = i2c_get_index(i2c);
+    assert(!instances[index]);
+    assert(DMA_IRQ_0 == DMA_IRQ_num || DMA_IRQ_1 == DMA_IRQ_num);
+
+    d->i2c = i2c;
+    d->DMA_IRQ_num = DMA_IRQ_num;
+    d->busy = false;
+    d->ok = true;
+    d->aborts = 0;
+    d->tx_dma = dma_claim_unused_channel(true);
+    d->rx_dma = dma_claim_unused_channel(true);
+
+    // TX: palavras de 32 bits da memória para IC_DATA_CMD, cadenciadas pela FIFO de TX
+    d->tx_dma_cfg = dma_channel_get_default_config(d->tx_dma);
+    channel_config_set_transfer_data_size(&d->tx_dma_cfg, DMA_SIZE_32);
+    channel_config_set_read_increment(&d->tx_dma_cfg, true);
+    channel_config_set_write_increment(&d->tx_dma_cfg, false);
+    channel_config_set_dreq(&d->tx_dma_cfg, index ? DREQ_I2C1_TX : DREQ_I2C0_TX);
+
+    // RX: bytes de IC_DATA_CMD para o destino, cadenciados pela FIFO de RX
+    d->rx_dma_cfg = dma_channel_get_default_config(d->rx_dma);
+    channel_config_set_transfer_data_size(&d->rx_dma_cfg, DMA_SIZE_8);
+    channel_config_set_read_increment(&d->rx_dma_cfg, false);
+    channel_config_set_write_increment(&d->rx_dma_cfg, true);
+    channel_config_set_dreq(&d->rx_dma_cfg, index ? DREQ_I2C1_RX : DREQ_I2C0_RX);
+
+    i2c_hw_t *hw = i2c_get_hw(i2c);
+    hw->dma_cr = I2C_IC_DMA_CR_TDMAE_BITS | I2C_IC_DMA_CR_RDMAE_BITS;
+    hw->intr_mask = 0;
+
+    // Só o fim do RX interessa: se o último byte chegou, o TX também terminou
+    instances[index] = d;
+    dma_irq_set_enabled(d, true);
+    irq_add_shared_handler(DMA_IRQ_num, DMA_IRQ_num == DMA_IRQ_0 ? dma_irq_handler_0 : dma_irq_handler_1,
+                           PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
+    irq_set_enabled(DMA_IRQ_num, true);
+    irq_set_exclusive_handler(index ? I2C1_IRQ : I2C0_IRQ, index ? abort_irq_handler_1 : abort_irq_handler_0);
+    irq_set_enabled(index ? I2C1_IRQ : I2C0_IRQ, true);
+    return true;
+}
+
+// Lê len bytes a partir do registrador reg. Retorna false se já houver uma
+// transferência em andamento. dst deve continuar válido até o callback.
+bool __not_in_flash_func(i2c_dma_read_regs_async)(i2c_dma_t *d, uint8_t addr, uint8_t reg, uint8_t *dst,
+                                                  size_t len, i2c_dma_callback_t callback, void *ctx)
+{
+    if (d->busy || !len || len > I2C_DMA_MAX_LEN)
+        return false;
+
+    d->cmd[0] = reg;
+    for (size_t i = 0; i < len; i++)
+        d->cmd[1 + i] = I2C_IC_DATA_CMD_CMD_BITS;
+    d->cmd[1] |= I2C_IC_DATA_CMD_RESTART_BITS;
+    d->cmd[len] |= I2C_IC_DATA_CMD_STOP_BITS;
+
+    i2c_hw_t *hw = i2c_get_hw(d->i2c);
+    hw->enable = 0;
+    hw->tar = addr;
+    hw->enable = 1;
+
+    d->busy = true;
+    d->write = false;
+    d->callback = callback;
+    d->ctx = ctx;
+    (void)hw->clr_tx_abrt;
+    hw->intr_mask = I2C_IC_INTR_MASK_M_TX_ABRT_BITS;
+
+    TRACE_BEGIN(TRACE_EV_I2C_READ);
+    dma_channel_configure(d->rx_dma, &d->rx_dma_cfg, dst, &hw->data_cmd, len, false);
+    dma_channel_configure(d->tx_dma, &d->tx_dma_cfg, &hw->data_cmd, d->cmd, len + 1, false);
+    dma_start_channel_mask((1u << d->tx_dma) | (1u << d->rx_dma));
+    return true;
+}
+
+// Escreve len bytes a partir do registrador reg. Retorna false se já houver
+// uma transferência em andamento. Os dados são copiados: src pode ser liberado
+// no retorno.
+bool __not_in_flash_func(i2c_dma_write_regs_async)(i2c_dma_t *d, uint8_t addr, uint8_t reg, const uint8_t *src,
+                                                   size_t len, i2c_dma_callback_t callback, void *ctx)
+{
+    if (d->busy || !len || len > I2C_DMA_MAX_LEN)
+        return false;
+
+    d->cmd[0] = reg;
+    for (size_t i = 0; i < len; i++)
+        d->cmd[1 + i] = src[i];
+    d->cmd[len] |= I2C_IC_DATA_CMD_STOP_BITS;
+
+    i2c_hw_t *hw = i2c_get_hw(d->i2c);
+    hw->enable = 0;
+    hw->tar = addr;
+    hw->enable = 1;
+
+    d->busy = true;
+    d->write = true;
+    d->callback = callback;
+    d->ctx = ctx;
+    (void)hw->clr_tx_abrt;
+    (void)hw->clr_stop_det; // STOP de uma transferência anterior
+    hw->intr_mask = I2C_IC_INTR_MASK_M_TX_ABRT_BITS | I2C_IC_INTR_MASK_M_STOP_DET_BITS;
+
+    dma_channel_configure(d->tx_dma, &d->tx_dma_cfg, &hw->data_cmd, d->cmd, len + 1, true);
+    return true;
+}
+
+// Espera a transferência atual terminar; cancela se passar de timeout_us.
+// Não pode ser chamada de uma interrupção de prioridade igual ou maior que a do DMA.
+bool i2c_dma_wait(i2c_dma_t *d, uint32_t timeout_us)
+{
+    absolute_time_t deadline = make_timeout_time_us(timeout_us);
+    while (d->busy)
+    {
+        if (time_reached(deadline))
+        {
+            uint32_t save = save_and_disable_interrupts();
+            if (d->busy)
+            {
+                i2c_dma_cancel(d);
+                i2c_dma_finish(d, false);
+            }
+            restore_interrupts(save);
+            break;
+        }
+        tight_loop_contents();
+    }
+    return d->ok;
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,66 @@
+/* i2c_dma.h
+Transferências I2C assíncronas por DMA, no estilo de spi_transfer().
+
+Um canal de DMA alimenta o IC_DATA_CMD com palavras de comando de 32 bits
+(endereço do registrador, depois um comando de leitura por byte com RESTART no
+primeiro e STOP no último), cadenciado pelo DREQ de TX. Outro canal recolhe os
+bytes recebidos, cadenciado pelo DREQ de RX. O fim do canal de RX gera a
+interrupção que chama o callback de conclusão; um NACK (TX_ABRT) cancela os
+dois canais e chama o mesmo callback com ok = false.
+
+Escritas usam só o canal de TX (registrador e dados, STOP no último byte); o
+fim do DMA não é o fim no barramento, então a conclusão vem da interrupção
+STOP_DET do bloco I2C.
+
+A CPU fica livre durante toda a transferência. Enquanto uma transferência
+estiver em andamento, as funções bloqueantes do SDK não devem usar o mesmo I2C.
+*/
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+//
+#include "hardware/dma.h"
+#include "hardware/i2c.h"
+#include "hardware/irq.h"
+
+#define I2C_DMA_MAX_LEN 1024 // Maior leitura aceita (a FIFO do MPU6050 inteira)
+
+// Chamado em contexto de interrupção no núcleo que executou i2c_dma_init()
+typedef void (*i2c_dma_callback_t)(bool ok, void *ctx);
+
+typedef struct {
+    i2c_inst_t *i2c;
+    uint tx_dma;
+    uint rx_dma;
+    uint DMA_IRQ_num; // DMA_IRQ_0 ou DMA_IRQ_1
+    dma_channel_config tx_dma_cfg;
+    dma_channel_config rx_dma_cfg;
+    volatile bool busy;
+    bool write;            // Transferência atual é uma escrita: termina no STOP_DET
+    volatile bool ok;      // Resultado da última transferência
+    volatile uint32_t aborts; // Transferências encerradas por NACK ou timeout
+    i2c_dma_callback_t callback;
+    void *ctx;
+    uint32_t cmd[I2C_DMA_MAX_LEN + 1]; // Palavras de comando do IC_DATA_CMD
+} i2c_dma_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+bool i2c_dma_init(i2c_dma_t *d, i2c_inst_t *i2c, uint DMA_IRQ_num);
+bool i2c_dma_read_regs_async(i2c_dma_t *d, uint8_t addr, uint8_t reg, uint8_t *dst, size_t len,
+                             i2c_dma_callback_t callback, void *ctx);
+bool i2c_dma_write_regs_async(i2c_dma_t *d, uint8_t addr, uint8_t reg, const uint8_t *src, size_t len,
+                              i2c_dma_callback_t callback, void *ctx);
+bool i2c_dma_wait(i2c_dma_t *d, uint32_t timeout_us);
+
+static inline bool i2c_dma_busy(const i2c_dma_t *d) { return d->busy; }
+
+#ifdef __cplusplus
+}
+#endif
+
+/* [] END OF FILE */
@@ -0,0 +1,74 @@
+/* imu_log_format.h
+Formato binário dos arquivos de gravação do MPU6050 (imu_data.bin).
+
+Compartilhado entre o firmware e o conversor ArquivosDados/imu_bin2csv.cpp.
+Todos os campos são little-endian, como no RP2040 e nos PCs.
+
+    +--------------------------+  0
+    | imu_log_header_t         |  512 bytes: um setor, descreve a gravação
+    +--------------------------+  512
+    | imu_log_record_t[0]      |  16 bytes por amostra, 32 por setor
+    | imu_log_record_t[1]      |
+    | ...                      |
+    +--------------------------+
+
+Os canais são os valores brutos do sensor; o valor físico é bruto / escala
+(accel_lsb_per_g, gyro_lsb_per_dps). dt_us é o intervalo desde a amostra
+anterior (0 na primeira), então o instante da amostra n é a soma de dt_us
+das amostras 0..n.
+*/
+#pragma once
+
+#include <stdint.h>
+
+#define IMU_LOG_MAGIC 0x474C4D49u // "IMLG" lido como uint32_t little-endian
+#define IMU_LOG_VERSION 1
+#define IMU_LOG_HEADER_SIZE 512
+
+// Modos de aquisição gravados em acq_mode (mesma ordem do comando 'mode')
+#define IMU_LOG_ACQ_POLL 0
+#define IMU_LOG_ACQ_FIFO 1
+#define IMU_LOG_ACQ_IRQ 2
+
+typedef struct {
+    uint32_t magic;           // IMU_LOG_MAGIC
+    uint16_t version;         // IMU_LOG_VERSION
+    uint16_t header_size;     // IMU_LOG_HEADER_SIZE: os registros começam aqui
+    uint16_t record_size;     // sizeof(imu_log_record_t)
+    uint16_t reserved0;
+    uint32_t sample_rate_hz;  // Taxa efetiva de amostragem
+    float accel_lsb_per_g;    // 16384 para ±2 g
+    float gyro_lsb_per_dps;   // 131 para ±250 °/s
+    // Configuração do sensor no início da gravação
+    uint8_t acq_mode;         // IMU_LOG_ACQ_*
+    uint8_t dlpf_cfg;         // CONFIG.DLPF_CFG
+    uint8_t gyro_fs_sel;      // GYRO_CONFIG.FS_SEL
+    uint8_t accel_fs_sel;     // ACCEL_CONFIG.AFS_SEL
+    uint8_t smplrt_div;       // SMPLRT_DIV
+    uint8_t reserved1[3];
+    // Início da gravação segundo o RTC (zeros se o RTC não foi ajustado)
+    int16_t start_year;
+    int8_t start_month;
+    int8_t start_day;
+    int8_t start_hour;
+    int8_t start_min;
+    int8_t start_sec;
+    int8_t reserved2;
+    uint8_t padding[IMU_LOG_HEADER_SIZE - 40];
+} imu_log_header_t;
+
+typedef struct {
+    uint32_t dt_us;           // Intervalo desde a amostra anterior
+    int16_t accel[3];
+    int16_t gyro[3];
+} imu_log_record_t;
+
+#ifdef __cplusplus
+static_assert(sizeof(imu_log_header_t) == IMU_LOG_HEADER_SIZE, "cabeçalho deve ocupar um setor");
+static_assert(sizeof(imu_log_record_t) == 16, "registro deve ter 16 bytes");
+#else
+_Static_assert(sizeof(imu_log_header_t) == IMU_LOG_HEADER_SIZE, "cabeçalho deve ocupar um setor");
+_Static_assert(sizeof(imu_log_record_t) == 16, "registro deve ter 16 bytes");
+#endif
+
+/* [] END OF FILE */
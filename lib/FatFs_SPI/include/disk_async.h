@@ -0,0 +1,46 @@
+/* disk_async.h
+Asynchronous sector reads and writes, next to the synchronous diskio.h API.
+
+disk_write_async() and disk_read_async() queue a transfer and return at once;
+buff belongs to the queue until the callback runs. There is no RTOS here, so
+the transfers are advanced by disk_async_poll(), which never waits on the
+card; call it from the main loop. Callbacks run inside disk_async_poll() or
+disk_async_flush(), on the caller's core. Reads and writes share one queue
+and complete in submission order.
+
+FatFs itself (metadata, FAT, directory entries) keeps using the synchronous
+disk_read/disk_write/disk_ioctl. Those drain the queue first, so FatFs always
+sees the card idle and the writes land in submission order. A queued transfer
+that fails is reported to its own callback only, never to whoever drains the
+queue next. All of this is single-core: call it from the same core that uses
+FatFs. */
+#pragma once
+
+#include "ff.h"
+#include "diskio.h"
+
+#ifndef DISK_ASYNC_QUEUE_LEN
+#  define DISK_ASYNC_QUEUE_LEN 4
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef void (*disk_async_callback_t)(DRESULT result, void *ctx);
+
+/* Return RES_OK once queued, or RES_NOTRDY when the queue is full (poll and
+retry). A transfer the card rejects is reported through the callback. */
+DRESULT disk_write_async(BYTE pdrv, const BYTE *buff, LBA_t sector, UINT count,
+                         disk_async_callback_t callback, void *ctx);
+DRESULT disk_read_async(BYTE pdrv, BYTE *buff, LBA_t sector, UINT count,
+                        disk_async_callback_t callback, void *ctx);
+void disk_async_poll(void);
+void disk_async_flush(void);     // Blocks until the queue is empty
+UINT disk_async_pending(void);   // Queued transfers, including the one in progress
+
+#ifdef __cplusplus
+}
+#endif
+
+/* [] END OF FILE */
@@ -0,0 +1,43 @@
+/* f_lines.h
+Block-buffered line reader: a faster f_gets for text files.
+
+f_gets reads one byte per f_read call and round-trips every character
+through the FF_STRF_ENCODE code conversion. This reader fills a caller
+buffer with large, sector-aligned f_reads (multi-block CMD18 reads straight
+into the buffer), finds newlines a word at a time, and returns lines as
+pointers into the buffer with no copying and no code conversion. The bytes
+come back exactly as stored, which for UTF-8 text on a UTF-8 console is what
+f_gets produces anyway.
+
+Lines are not NUL-terminated. A line longer than the buffer is returned in
+buffer-sized pieces; only the last piece ends in '\n'. */
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "ff.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    FIL *fp;
+    char *buf;
+    size_t size;    // Buffer size: a multiple of 512 keeps every f_read aligned
+    size_t pos;     // Start of the next line
+    size_t len;     // Valid bytes in buf
+    bool eof;
+    FRESULT fr;     // First f_read error, if any
+} f_lines_t;
+
+void f_lines_init(f_lines_t *lr, FIL *fp, void *buf, size_t size);
+/* Next line (with its '\n', if any) and its length, or NULL at end of file
+or on a read error (see lr->fr). The pointer is valid until the next call. */
+const char *f_lines_next(f_lines_t *lr, size_t *len);
+
+#ifdef __cplusplus
+}
+#endif
+
+/* [] END OF FILE */
@@ -0,0 +1,43 @@
+/* f_stream.h
+Streaming reads: hand a whole file to a consumer in large chunks.
+
+The file's cluster chain is mapped once with the fast-seek link map
+(FF_USE_FASTSEEK), then its data is read straight from the card with
+multi-block CMD18 reads into the two halves of the caller's buffer. While
+the sink consumes one half, the next read is already queued on the
+disk_async.h queue; a sink that calls disk_async_poll() between pieces of
+slow work (USB output, formatting) keeps the card busy in parallel.
+
+Each read stays inside one fragment of the file and is at most half the
+buffer, so with a buffer of two clusters every read is one whole cluster.
+Files that cannot be mapped (more than F_STREAM_FRAGMENTS fragments, open for
+writing, or an unaligned position) are streamed through plain f_read calls
+of the same size instead. */
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "ff.h"
+
+#ifndef F_STREAM_FRAGMENTS
+#  define F_STREAM_FRAGMENTS 16
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Called once per chunk, in file order. Return false to stop early. */
+typedef bool (*f_stream_sink_t)(const void *data, size_t len, void *ctx);
+
+/* Stream from the current position to the end of the file. size is split in
+two halves, each rounded down to whole sectors (so at least 1 KiB). The
+position is left at the end of the file, or where the sink stopped. */
+FRESULT f_stream(FIL *fp, void *buf, size_t size, f_stream_sink_t sink,
+                 void *ctx);
+
+#ifdef __cplusplus
+}
+#endif
+
+/* [] END OF FILE */
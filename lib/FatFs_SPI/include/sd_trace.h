@@ -0,0 +1,16 @@
+/* sd_trace.h
+Trace points of the SD stack (glue.c, sd_card.c, spi.c).
+
+With USE_TRACE the application's trace.h provides TRACE_BEGIN/TRACE_END and
+the event ids, and must be on the include path. Otherwise the macros are
+empty here, so the library builds without anything from the application. */
+#pragma once
+
+#if defined(USE_TRACE) && USE_TRACE
+#  include "trace.h"
+#else
+#  define TRACE_BEGIN(id) ((void)0)
+#  define TRACE_END(id) ((void)0)
+#endif
+
+/* [] END OF FILE */
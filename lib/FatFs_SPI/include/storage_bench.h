@@ -0,0 +1,80 @@
+/* storage_bench.h
+Storage benchmark over the whole stack: FatFs, the async queue and the card
+driver, through temporary files on a mounted volume.
+
+Each measurement is one row: sequential write and read throughput, random
+512 B read and write latency, latency of small appends (64 B to 32 KiB),
+the cost of f_sync after an append, and a cold mount (card init and clock
+negotiation included). Latencies come as p50/p99/max in microseconds, from
+time_us_64(). The rows format as CSV lines with the card's SCK and size, so
+runs on different cards and driver versions can be compared; the shell's
+'bench' command and the host's bench_storage print the same columns. */
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "ff.h"
+
+#ifndef BENCH_APPEND_N
+#  define BENCH_APPEND_N 64  // Appends timed per size
+#endif
+#ifndef BENCH_RANDOM_N
+#  define BENCH_RANDOM_N 64  // Random sector reads, and as many writes
+#endif
+#ifndef BENCH_MOUNT_N
+#  define BENCH_MOUNT_N 3    // Cold mounts timed
+#endif
+
+// Rows bench_run() can produce: sequential, random, appends, f_sync, mount
+#define BENCH_ROWS 10
+
+#define BENCH_CSV_HEADER "teste,bytes,n,mb_s,p50_us,p99_us,max_us,spi_hz,setores\n"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    const char *test;
+    uint32_t bytes;  // Size of each operation
+    uint32_t n;      // Operations timed
+    float mb_s;      // Throughput; 0 where it does not apply
+    uint32_t p50_us, p99_us, max_us;
+} bench_row_t;
+
+/* Write a file of kib KiB in size-byte f_writes (the closing f_sync
+included), then read it back: rows[0] and rows[1]. The file is left in
+place for bench_random(). */
+FRESULT bench_sequential(const char *path, uint8_t *buf, size_t size,
+                         uint32_t kib, bench_row_t rows[2]);
+/* BENCH_RANDOM_N reads, then as many writes, of one sector at random
+sector-aligned offsets of an existing file: rows[0] and rows[1]. */
+FRESULT bench_random(const char *path, uint8_t *buf, bench_row_t rows[2]);
+/* BENCH_APPEND_N f_writes of size bytes to the end of a new file, as the
+logger does. With sync, time only the f_sync after each one. */
+FRESULT bench_append(const char *path, const uint8_t *buf, size_t size,
+                     bool sync, bench_row_t *row);
+/* Unmount and mount drive BENCH_MOUNT_N times, forcing the card through
+its init each time as if it had just been inserted. On failure fs is left
+unmounted (fs->fs_type is 0). */
+FRESULT bench_mount(FATFS *fs, const char *drive, bench_row_t *row);
+
+/* Run all of the above on drive, which fs must have mounted, with path as
+the temporary file. buf holds the data: size bytes, 32 KiB for every
+append size. Returns the rows filled, which stop at the first error
+(*fr). */
+size_t bench_run(FATFS *fs, const char *drive, const char *path, uint8_t *buf,
+                 size_t size, uint32_t kib, bench_row_t rows[BENCH_ROWS],
+                 FRESULT *fr);
+
+/* One CSV line, with the BENCH_CSV_HEADER columns and a '\n'. Returns what
+snprintf returns. */
+int bench_format_row(char *line, size_t len, const bench_row_t *row,
+                     uint32_t spi_hz, uint64_t sectors);
+
+#ifdef __cplusplus
+}
+#endif
+
+/* [] END OF FILE */
@@ -96,7 +96,7 @@ char crc7(const char* data, int length)
 	return crc;
 }
 
-unsigned short crc16(const char* data, int length)
+unsigned short crc16_bytewise(const char* data, int length)
 {
 	//Calculate the CRC16 checksum for the specified data block
 	unsigned short crc = 0;
@@ -108,9 +108,62 @@ unsigned short crc16(const char* data, int length)
 	return crc;
 }
 
+#if CRC16_SLICES != 4 && CRC16_SLICES != 8
+#  error "CRC16_SLICES must be 4 or 8"
+#endif
+
+/* Slice-by-N: m_Crc16Slices[k][b] is the CRC of byte b followed by k zero
+bytes, so N input bytes fold into the CRC with N independent lookups instead
+of a chain of N dependent ones. Row 0 is m_Crc16Table. */
+static uint16_t m_Crc16Slices[CRC16_SLICES][256];
+static volatile int m_Crc16SlicesReady;
+
+static void crc16_build_slices(void)
+{
+	for (int b = 0; b < 256; b++) {
+		m_Crc16Slices[0][b] = m_Crc16Table[b];
+	}
+	for (int k = 1; k < CRC16_SLICES; k++) {
+		for (int b = 0; b < 256; b++) {
+			uint16_t prev = m_Crc16Slices[k - 1][b];
+			m_Crc16Slices[k][b] = (prev << 8) ^ m_Crc16Table[prev >> 8];
+		}
+	}
+	m_Crc16SlicesReady = 1;
+}
+
+uint16_t crc16_sliced(const void *data, size_t length, uint16_t crc)
+{
+	const uint8_t *p = data;
+	if (!m_Crc16SlicesReady) {
+		crc16_build_slices();
+	}
+	while (length >= CRC16_SLICES) {
+		// The CRC overlaps the first two bytes of each step
+		uint16_t c = m_Crc16Slices[CRC16_SLICES - 1][p[0] ^ (crc >> 8)] ^
+		             m_Crc16Slices[CRC16_SLICES - 2][p[1] ^ (crc & 0xFF)] ^
+		             m_Crc16Slices[CRC16_SLICES - 3][p[2]] ^
+		             m_Crc16Slices[CRC16_SLICES - 4][p[3]];
+#if CRC16_SLICES == 8
+		c ^= m_Crc16Slices[3][p[4]] ^ m_Crc16Slices[2][p[5]] ^
+		     m_Crc16Slices[1][p[6]] ^ m_Crc16Slices[0][p[7]];
+#endif
+		crc = c;
+		p += CRC16_SLICES;
+		length -= CRC16_SLICES;
+	}
+	while (length--) {
+		crc = (crc << 8) ^ m_Crc16Slices[0][(crc >> 8) ^ *p++];
+	}
+	return crc;
+}
+
+unsigned short crc16(const char* data, int length)
+{
+	return crc16_sliced(data, length, 0);
+}
+
 void update_crc16(unsigned short *pCrc16, const char data[], size_t length) {
-	for (size_t i = 0; i < length; i++) {
-		*pCrc16 = (*pCrc16 << 8) ^ m_Crc16Table[((*pCrc16 >> 8) ^ data[i]) & 0x00FF];
-	}    
+	*pCrc16 = crc16_sliced(data, length, *pCrc16);
 }
 /* [] END OF FILE */
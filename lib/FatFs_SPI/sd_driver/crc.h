@@ -32,10 +32,22 @@ specific language governing permissions and limitations under the License.
 #define SD_CRC_H
 
 #include <stddef.h>
+#include <stdint.h>
+
+/* Bytes consumed per step by crc16_sliced(): 4 or 8. The tables live in RAM
+(CRC16_SLICES * 512 bytes) because a flash-resident table would miss the XIP
+cache on every lookup. */
+#ifndef CRC16_SLICES
+#  define CRC16_SLICES 4
+#endif
     
 char crc7(const char* data, int length);
 unsigned short crc16(const char* data, int length);
 void update_crc16(unsigned short *pCrc16, const char data[], size_t length);
+// The original byte-at-a-time table loop, kept as the reference for crc16()
+unsigned short crc16_bytewise(const char* data, int length);
+// CRC16-CCITT (XMODEM) continuing from crc; crc16() is crc16_sliced(d, n, 0)
+uint16_t crc16_sliced(const void *data, size_t length, uint16_t crc);
 
 #endif
 
@@ -174,6 +174,7 @@ specific language governing permissions and limitations under the License.
 #include "ff.h" /* Obtains integer types */
 //
 #include "diskio.h" /* Declarations of disk functions */  // Needed for STA_NOINIT, ...
+#include "sd_trace.h"
 
 #ifndef SD_CRC_ENABLED
 #define SD_CRC_ENABLED 1
@@ -300,6 +301,7 @@ static uint8_t sd_cmd_spi(sd_card_t *pSD, cmdSupported cmd, uint32_t arg) {
 
     // Prepare the command packet
     cmdPacket[0] = SPI_CMD(cmd);
+    pSD->stats.commands[cmd & 0x3F]++;
     cmdPacket[1] = (arg >> 24);
     cmdPacket[2] = (arg >> 16);
     cmdPacket[3] = (arg >> 8);
@@ -326,9 +328,7 @@ static uint8_t sd_cmd_spi(sd_card_t *pSD, cmdSupported cmd, uint32_t arg) {
         }
     }
     // send a command
-    for (int i = 0; i < PACKET_SIZE; i++) {
-        sd_spi_write(pSD, cmdPacket[i]);
-    }
+    sd_spi_transfer(pSD, (const uint8_t *)cmdPacket, NULL, PACKET_SIZE);
     // The received byte immediataly following CMD12 is a stuff byte,
     // it should be discarded before receive the response of the CMD12.
     if (CMD12_STOP_TRANSMISSION == cmd) {
@@ -352,10 +352,14 @@ static bool sd_wait_ready(sd_card_t *pSD, int timeout) {
     // Keep sending dummy clocks with DI held high until the card releases the
     // DO line
     absolute_time_t timeout_time = make_timeout_time_ms(timeout);
+    uint32_t t0 = time_us_32();
+    TRACE_BEGIN(TRACE_EV_SD_WAIT_READY);
     do {
         resp = sd_spi_write(pSD, 0xFF);
     } while (resp == 0x00 &&
              0 < absolute_time_diff_us(get_absolute_time(), timeout_time));
+    TRACE_END(TRACE_EV_SD_WAIT_READY);
+    pSD->stats.wait_ready_us += time_us_32() - t0;
 
     if (resp == 0x00) DBG_PRINTF("%s failed\r\n", __FUNCTION__);
 
@@ -477,6 +481,7 @@ static int sd_cmd(sd_card_t *pSD, const cmdSupported cmd, uint32_t arg,
         response = sd_cmd_spi(pSD, cmd, arg);
         if (R1_NO_RESPONSE == response) {
             DBG_PRINTF("No response CMD:%d\r\n", cmd);
+            if (i + 1 < SD_COMMAND_RETRIES) pSD->stats.command_retries++;
             continue;
         }
         break;
@@ -493,6 +498,7 @@ static int sd_cmd(sd_card_t *pSD, const cmdSupported cmd, uint32_t arg,
     }
     if (response & R1_COM_CRC_ERROR && ACMD23_SET_WR_BLK_ERASE_COUNT != cmd) {
         DBG_PRINTF("CRC error CMD:%d response 0x%" PRIx32 "\r\n", cmd, response);
+        pSD->stats.crc_errors++;
         return SD_BLOCK_DEVICE_ERROR_CRC;  // CRC error
     }
     if (response & R1_ILLEGAL_COMMAND) {
@@ -759,19 +765,50 @@ uint64_t sd_sectors(sd_card_t *pSD) {
     return sectors;
 }
 
+/* Allocation unit (AU) size in sectors, from the 64-byte SD Status register
+(ACMD13, response R2 + data block). AU_SIZE is SD_STATUS[431:428]. The
+result is rounded down to a power of two no larger than 32768 sectors, which
+is what FatFs accepts for GET_BLOCK_SIZE; 0 if the card doesn't say. */
+uint32_t sd_allocation_unit(sd_card_t *pSD) {
+    static const uint32_t au_kib[16] = {
+        0,    16,   32,   64,    128,   256,   512,   1024,
+        2048, 4096, 8192, 12288, 16384, 24576, 32768, 65536};
+    if (pSD->m_Status & (STA_NOINIT | STA_NODISK)) return 0;
+    sd_acquire(pSD);
+    uint8_t status[64];
+    int rc = sd_cmd(pSD, ACMD13_SD_STATUS, 0, true, 0);
+    if (SD_BLOCK_DEVICE_ERROR_NONE == rc)
+        rc = sd_read_bytes(pSD, status, sizeof status);
+    sd_release(pSD);
+    if (SD_BLOCK_DEVICE_ERROR_NONE != rc) {
+        DBG_PRINTF("%s: couldn't read SD Status\r\n", __FUNCTION__);
+        return 0;
+    }
+    uint32_t sectors = au_kib[status[10] >> 4] * 2u;
+    // 12 MB and 24 MB: the largest power of two that divides them
+    sectors &= -sectors;
+    if (sectors > 32768) sectors = 32768;
+    DBG_PRINTF("AU_SIZE: %u, %lu sectors\r\n", status[10] >> 4, (unsigned long)sectors);
+    return sectors;
+}
+
 // SPI function to wait till chip is ready and sends start token
 static bool sd_wait_token(sd_card_t *pSD, uint8_t token) {
     TRACE_PRINTF("%s(0x%02hhx)\r\n", __FUNCTION__, token);
 
     const uint32_t timeout = SD_COMMAND_TIMEOUT;  // Wait for start token
     absolute_time_t timeout_time = make_timeout_time_ms(timeout);
+    uint32_t t0 = time_us_32();
+    bool found = false;
     do {
         if (token == sd_spi_write(pSD, SPI_FILL_CHAR)) {
-            return true;
+            found = true;
+            break;
         }
     } while (0 < absolute_time_diff_us(get_absolute_time(), timeout_time));
-    DBG_PRINTF("sd_wait_token: timeout\r\n");
-    return false;
+    pSD->stats.wait_token_us += time_us_32() - t0;
+    if (!found) DBG_PRINTF("sd_wait_token: timeout\r\n");
+    return found;
 }
 
 #define SPI_START_BLOCK \
@@ -786,12 +823,13 @@ static int sd_read_bytes(sd_card_t *pSD, uint8_t *buffer, uint32_t length) {
         return SD_BLOCK_DEVICE_ERROR_NO_RESPONSE;
     }
     // read data
-    for (uint32_t i = 0; i < length; i++) {
-        buffer[i] = sd_spi_write(pSD, SPI_FILL_CHAR);
+    if (!sd_spi_transfer(pSD, NULL, buffer, length)) {
+        return SD_BLOCK_DEVICE_ERROR_NO_RESPONSE;
     }
     // Read the CRC16 checksum for the data block
-    crc = (sd_spi_write(pSD, SPI_FILL_CHAR) << 8);
-    crc |= sd_spi_write(pSD, SPI_FILL_CHAR);
+    uint8_t crc_bytes[2];
+    sd_spi_transfer(pSD, NULL, crc_bytes, sizeof crc_bytes);
+    crc = (crc_bytes[0] << 8) | crc_bytes[1];
 
 #if SD_CRC_ENABLED
     if (crc_on) {
@@ -802,6 +840,7 @@ static int sd_read_bytes(sd_card_t *pSD, uint8_t *buffer, uint32_t length) {
             DBG_PRINTF("_read_bytes: Invalid CRC received 0x%" PRIx16
                        " result of computation 0x%" PRIx16 "\r\n",
                        crc, (uint16_t)crc_result);
+            pSD->stats.crc_errors++;
             return SD_BLOCK_DEVICE_ERROR_CRC;
         }
     }
@@ -817,24 +856,31 @@ static int sd_read_block(sd_card_t *pSD, uint8_t *buffer, uint32_t length) {
         DBG_PRINTF("%s:%d Read timeout\r\n", __FILE__, __LINE__);
         return SD_BLOCK_DEVICE_ERROR_NO_RESPONSE;
     }
-    // read data
-    // bool spi_transfer(const uint8_t *tx, uint8_t *rx, size_t length)
-    if (!sd_spi_transfer(pSD, NULL, buffer, length)) {
+    // read data, with its CRC computed on the way in
+    uint16_t crc_result = 0;
+    bool ok;
+#if SD_CRC_ENABLED
+    if (crc_on)
+        ok = sd_spi_transfer_crc16(pSD, NULL, buffer, length, &crc_result);
+    else
+#endif
+        ok = sd_spi_transfer(pSD, NULL, buffer, length);
+    if (!ok) {
         return SD_BLOCK_DEVICE_ERROR_NO_RESPONSE;
     }
     // Read the CRC16 checksum for the data block
-    crc = (sd_spi_write(pSD, SPI_FILL_CHAR) << 8);
-    crc |= sd_spi_write(pSD, SPI_FILL_CHAR);
+    uint8_t crc_bytes[2];
+    sd_spi_transfer(pSD, NULL, crc_bytes, sizeof crc_bytes);
+    crc = (crc_bytes[0] << 8) | crc_bytes[1];
 
 #if SD_CRC_ENABLED
     if (crc_on) {
-        uint32_t crc_result;
-        // Compute and verify checksum
-        crc_result = crc16((void *)buffer, length);
-        if ((uint16_t)crc_result != crc) {
+        // Verify checksum
+        if (crc_result != crc) {
             DBG_PRINTF("%s: Invalid CRC received 0x%" PRIx16
                        " result of computation 0x%" PRIx16 "\r\n",
                        __FUNCTION__, crc, (uint16_t)crc_result);
+            pSD->stats.crc_errors++;
             return SD_BLOCK_DEVICE_ERROR_CRC;
         }
     }
@@ -888,12 +934,98 @@ static int in_sd_read_blocks(sd_card_t *pSD, uint8_t *buffer,
     return rd_status ? rd_status : status;
 }
 
+/* SCK frequencies tried at init, fastest first. Each is capped at
+spi->baud_rate, so the configured rate is a ceiling rather than a setting.
+The divider rounds them down (25 MHz runs at 20.83 MHz), so the steps are
+compared by the rate spi_set_baudrate() returns. */
+static const uint sd_clock_ladder[] = {25000000, 20000000, 12500000, 6000000,
+                                       1000000};
+#define SD_CLOCK_TEST_READS 4        // CRC-checked reads a frequency must pass
+#define SD_CLOCK_STEP_DOWN_ERRORS 3  // Consecutive bus errors before stepping down
+#define SD_TRANSFER_RETRIES 2        // Retries of one transfer, plus one per step-down
+
+static uint sd_clock_rate(sd_card_t *pSD, size_t step) {
+    uint rate = sd_clock_ladder[step];
+    return rate < pSD->spi->baud_rate ? rate : pSD->spi->baud_rate;
+}
+
+static void sd_clock_apply(sd_card_t *pSD, size_t step) {
+    pSD->clock_step = step;
+    pSD->bus_errors = 0;
+    pSD->baud_rate =
+        spi_set_baudrate(pSD->spi->hw_inst, sd_clock_rate(pSD, step));
+    DBG_PRINTF("SD SCK: %u Hz\r\n", pSD->baud_rate);
+}
+
+/* Pick the fastest ladder frequency at which sector 0 reads back
+SD_CLOCK_TEST_READS times with a good CRC and the same contents as a reference
+copy read at the 400 kHz init clock. Called with the card acquired. */
+static void sd_negotiate_clock(sd_card_t *pSD) {
+    static uint8_t ref[512], test[512];
+    size_t last = count_of(sd_clock_ladder) - 1;
+    if (SD_BLOCK_DEVICE_ERROR_NONE != in_sd_read_blocks(pSD, ref, 0, 1)) {
+        DBG_PRINTF("%s: reference read failed\r\n", __FUNCTION__);
+        sd_clock_apply(pSD, last);
+        return;
+    }
+    uint failed = 0;
+    for (size_t step = 0; step <= last; step++) {
+        sd_clock_apply(pSD, step);
+        if (failed && pSD->baud_rate >= failed)
+            continue;  // Rounds to a frequency that already failed
+        bool ok = true;
+        for (int i = 0; ok && i < SD_CLOCK_TEST_READS; i++) {
+            ok = SD_BLOCK_DEVICE_ERROR_NONE ==
+                     in_sd_read_blocks(pSD, test, 0, 1) &&
+                 0 == memcmp(ref, test, sizeof test);
+        }
+        if (ok) return;
+        DBG_PRINTF("%s: %u Hz failed\r\n", __FUNCTION__, pSD->baud_rate);
+        failed = pSD->baud_rate;
+    }
+}
+
+/* Account for the outcome of a transfer. Returns true if the caller should
+retry it: after a CRC or timeout error, at the same clock until
+SD_CLOCK_STEP_DOWN_ERRORS in a row, then one ladder step slower. The callers
+stop after SD_TRANSFER_RETRIES regardless, so a dead card costs a few
+timeouts rather than one per error per ladder step, plus one try at each
+slower clock. */
+static bool sd_clock_check(sd_card_t *pSD, int status) {
+    if (SD_BLOCK_DEVICE_ERROR_CRC != status &&
+        SD_BLOCK_DEVICE_ERROR_NO_RESPONSE != status) {
+        pSD->bus_errors = 0;
+        return false;
+    }
+    if (++pSD->bus_errors < SD_CLOCK_STEP_DOWN_ERRORS) return true;
+    uint from = pSD->baud_rate;
+    for (size_t step = pSD->clock_step + 1; step < count_of(sd_clock_ladder);
+         step++) {
+        sd_clock_apply(pSD, step);
+        if (pSD->baud_rate < from) {
+            pSD->clock_step_downs++;
+            return true;
+        }
+    }
+    pSD->bus_errors = 0;  // Already at the slowest: give up on this transfer
+    return false;
+}
+
 int sd_read_blocks(sd_card_t *pSD, uint8_t *buffer, uint64_t ulSectorNumber,
                    uint32_t ulSectorCount) {
     sd_acquire(pSD);
     TRACE_PRINTF("sd_read_blocks(0x%p, 0x%llx, 0x%lx)\r\n", buffer,
                  ulSectorNumber, ulSectorCount);
-    int status = in_sd_read_blocks(pSD, buffer, ulSectorNumber, ulSectorCount);
+    int status;
+    for (int tries = 0;; tries++) {
+        uint32_t step_downs = pSD->clock_step_downs;
+        status = in_sd_read_blocks(pSD, buffer, ulSectorNumber, ulSectorCount);
+        if (!sd_clock_check(pSD, status)) break;
+        // Out of retries, unless the clock was just lowered: try that once
+        if (tries >= SD_TRANSFER_RETRIES && step_downs == pSD->clock_step_downs)
+            break;
+        pSD->stats.transfer_retries++;
+    }
     sd_release(pSD);
     return status;
 }
@@ -907,22 +1039,31 @@ static uint8_t sd_write_block(sd_card_t *pSD, const uint8_t *buffer,
     sd_spi_write(pSD, token);
 
     // write the data
-    bool ret = sd_spi_transfer(pSD, buffer, NULL, length);
+    bool sniff = false;
+#if SD_CRC_ENABLED
+    sniff = crc_on && pSD->spi->crc16_sniff;
+#endif
+    bool ret = sniff ? spi_transfer_start_crc16(pSD->spi, buffer, NULL, length)
+                     : sd_spi_transfer_start(pSD, buffer, NULL, length);
     myASSERT(ret);
 
 #if SD_CRC_ENABLED
-    if (crc_on) {
-        // Compute CRC
+    if (crc_on && !sniff) {
+        // Compute CRC while the DMA shifts the same block out
         crc = crc16((void *)buffer, length);
     }
 #endif
+    ret = sd_spi_transfer_wait_complete(pSD, 1000);
+    myASSERT(ret);
+    if (sniff) crc = spi_transfer_crc16(pSD->spi);
 
-    // write the checksum CRC16
-    sd_spi_write(pSD, crc >> 8);
-    sd_spi_write(pSD, crc);
-
-    // check the response token
-    response = sd_spi_write(pSD, SPI_FILL_CHAR);
+    // write the checksum CRC16 and clock in the response token
+    uint8_t trailer_tx[3] = {crc >> 8, crc, SPI_FILL_CHAR};
+    uint8_t trailer_rx[3];
+    sd_spi_transfer(pSD, trailer_tx, trailer_rx, sizeof trailer_tx);
+    response = trailer_rx[2];
+    if (SPI_DATA_CRC_ERROR == (response & SPI_DATA_RESPONSE_MASK))
+        pSD->stats.crc_errors++;
 
     // Wait for last block to be written
     if (false == sd_wait_ready(pSD, SD_COMMAND_TIMEOUT)) {
@@ -931,6 +1072,43 @@ static uint8_t sd_write_block(sd_card_t *pSD, const uint8_t *buffer,
     return (response & SPI_DATA_RESPONSE_MASK);
 }
 
+/* Finish a write according to pSD->status_check. status is the outcome of
+the data phase; a rejected write always gets its CMD13. */
+static int sd_write_status(sd_card_t *pSD, int status) {
+    bool check;
+    switch (pSD->status_check) {
+        case SD_STATUS_CHECK_EVERY_N:
+            check = ++pSD->writes_since_status >= pSD->status_check_interval;
+            break;
+        case SD_STATUS_CHECK_ON_SYNC:
+            ++pSD->writes_since_status;
+            check = false;
+            break;
+        default:
+            check = true;
+    }
+    if (!check && SD_BLOCK_DEVICE_ERROR_NONE == status)
+        return status;
+    pSD->writes_since_status = 0;
+    uint32_t stat = 0;
+    // Some SD cards want to be deselected between every bus transaction:
+    sd_spi_deselect_pulse(pSD);
+    int rc = sd_cmd(pSD, CMD13_SEND_STATUS, 0, false, &stat);
+    return status ? status : rc;
+}
+
+int sd_sync(sd_card_t *pSD) {
+    if (!pSD->writes_since_status)
+        return SD_BLOCK_DEVICE_ERROR_NONE;
+    sd_acquire(pSD);
+    pSD->writes_since_status = 0;
+    uint32_t stat = 0;
+    sd_spi_deselect_pulse(pSD);
+    int status = sd_cmd(pSD, CMD13_SEND_STATUS, 0, false, &stat);
+    sd_release(pSD);
+    return status;
+}
+
 /** Program blocks to a block device
  *
  *
@@ -945,9 +1123,12 @@ static uint8_t sd_write_block(sd_card_t *pSD, const uint8_t *buffer,
  *                  SD_BLOCK_DEVICE_ERROR_NO_INIT - device is not initialized
  *                  SD_BLOCK_DEVICE_ERROR_WRITE - SPI write error
  *                  SD_BLOCK_DEVICE_ERROR_ERASE - erase error
+ *  *data_sent is set once a multiple block write has sent data: from then on
+ *  some blocks may be programmed, so the write is not repeated blindly.
  */
 static int in_sd_write_blocks(sd_card_t *pSD, const uint8_t *buffer,
-                              uint64_t ulSectorNumber, uint32_t blockCnt) {
+                              uint64_t ulSectorNumber, uint32_t blockCnt,
+                              bool *data_sent) {
     if (ulSectorNumber + blockCnt > pSD->sectors)
         return SD_BLOCK_DEVICE_ERROR_PARAMETER;
     if (pSD->m_Status & (STA_NOINIT | STA_NODISK))
@@ -964,8 +1145,10 @@ static int in_sd_write_blocks(sd_card_t *pSD, const uint8_t *buffer,
     } else {
         addr = ulSectorNumber * _block_size;
     }
+    pSD->stats.blocks_written += blockCnt;
     // Send command to perform write operation
     if (blockCnt == 1) {
+        pSD->stats.single_block_writes++;
         // Single block write command
         if (SD_BLOCK_DEVICE_ERROR_NONE !=
             (status = sd_cmd(pSD, CMD24_WRITE_BLOCK, addr, false, 0))) {
@@ -980,6 +1163,7 @@ static int in_sd_write_blocks(sd_card_t *pSD, const uint8_t *buffer,
             status = SD_BLOCK_DEVICE_ERROR_WRITE;
         }
     } else {
+        pSD->stats.multi_block_writes++;
         // Pre-erase setting prior to multiple block write operation
         sd_cmd(pSD, ACMD23_SET_WR_BLK_ERASE_COUNT, blockCnt, 1, 0);
 
@@ -992,6 +1176,7 @@ static int in_sd_write_blocks(sd_card_t *pSD, const uint8_t *buffer,
             return status;
         }
         // Write the data: one block at a time
+        *data_sent = true;
         do {
             response = sd_write_block(pSD, buffer, SPI_START_BLK_MUL_WRITE, _block_size);
             if (response != SPI_DATA_ACCEPTED) {
@@ -1007,11 +1192,7 @@ static int in_sd_write_blocks(sd_card_t *pSD, const uint8_t *buffer,
          */
         sd_spi_write(pSD, SPI_STOP_TRAN);
     }
-    uint32_t stat = 0;
-    // Some SD cards want to be deselected between every bus transaction:
-    sd_spi_deselect_pulse(pSD);
-    status = sd_cmd(pSD, CMD13_SEND_STATUS, 0, false, &stat);
-    return status;
+    return sd_write_status(pSD, status);
 }
 
 int sd_write_blocks(sd_card_t *pSD, const uint8_t *buffer,
@@ -1019,11 +1200,294 @@ int sd_write_blocks(sd_card_t *pSD, const uint8_t *buffer,
     sd_acquire(pSD);
     TRACE_PRINTF("sd_write_blocks(0x%p, 0x%llx, 0x%lx)\r\n", buffer,
                  ulSectorNumber, blockCnt);
-    int status = in_sd_write_blocks(pSD, buffer, ulSectorNumber, blockCnt);
+    int status;
+    bool data_sent = false;
+    for (int tries = 0;; tries++) {
+        uint32_t step_downs = pSD->clock_step_downs;
+        status = in_sd_write_blocks(pSD, buffer, ulSectorNumber, blockCnt,
+                                    &data_sent);
+        if (!sd_clock_check(pSD, status) || data_sent) break;
+        if (tries >= SD_TRANSFER_RETRIES && step_downs == pSD->clock_step_downs)
+            break;
+        pSD->stats.transfer_retries++;
+    }
     sd_release(pSD);
     return status;
 }
 
+enum {
+    SD_WRITE_IDLE,
+    SD_WRITE_DATA,  // Block DMA in flight
+    SD_WRITE_BUSY   // Card programming: DO held low
+};
+
+// Send the start token and begin shifting the next block out by DMA
+static void sd_write_op_begin_block(sd_card_t *pSD) {
+    sd_write_op_t *op = &pSD->write_op;
+    sd_spi_write(pSD, op->multi ? SPI_START_BLK_MUL_WRITE : SPI_START_BLOCK);
+    op->crc_sniff = false;
+#if SD_CRC_ENABLED
+    op->crc_sniff = crc_on && pSD->spi->crc16_sniff;
+#endif
+    bool ret = op->crc_sniff
+                   ? spi_transfer_start_crc16(pSD->spi, op->buffer, NULL, _block_size)
+                   : sd_spi_transfer_start(pSD, op->buffer, NULL, _block_size);
+    myASSERT(ret);
+    op->crc = (~0);
+#if SD_CRC_ENABLED
+    if (crc_on && !op->crc_sniff) {
+        op->crc = crc16((void *)op->buffer, _block_size);
+    }
+#endif
+    op->deadline = make_timeout_time_ms(1000);
+    op->state = SD_WRITE_DATA;
+}
+
+int sd_write_blocks_start(sd_card_t *pSD, const uint8_t *buffer,
+                          uint64_t ulSectorNumber, uint32_t blockCnt) {
+    if (!blockCnt || ulSectorNumber + blockCnt > pSD->sectors)
+        return SD_BLOCK_DEVICE_ERROR_PARAMETER;
+    if (pSD->m_Status & (STA_NOINIT | STA_NODISK))
+        return SD_BLOCK_DEVICE_ERROR_PARAMETER;
+    myASSERT(SD_WRITE_IDLE == pSD->write_op.state);
+
+    sd_acquire(pSD);
+    TRACE_PRINTF("sd_write_blocks_start(0x%p, 0x%llx, 0x%lx)\r\n", buffer,
+                 ulSectorNumber, blockCnt);
+    uint64_t addr;
+    if (SDCARD_V2HC == pSD->card_type) {
+        addr = ulSectorNumber;
+    } else {
+        addr = ulSectorNumber * _block_size;
+    }
+    int status;
+    pSD->stats.blocks_written += blockCnt;
+    if (blockCnt == 1) {
+        pSD->stats.single_block_writes++;
+        status = sd_cmd(pSD, CMD24_WRITE_BLOCK, addr, false, 0);
+    } else {
+        pSD->stats.multi_block_writes++;
+        sd_cmd(pSD, ACMD23_SET_WR_BLK_ERASE_COUNT, blockCnt, 1, 0);
+        sd_spi_deselect_pulse(pSD);
+        status = sd_cmd(pSD, CMD25_WRITE_MULTIPLE_BLOCK, addr, false, 0);
+    }
+    if (SD_BLOCK_DEVICE_ERROR_NONE != status) {
+        sd_release(pSD);
+        return status;
+    }
+    sd_write_op_t *op = &pSD->write_op;
+    op->buffer = buffer;
+    op->remaining = blockCnt;
+    op->multi = blockCnt > 1;
+    op->stop_sent = false;
+    op->status = SD_BLOCK_DEVICE_ERROR_NONE;
+    sd_write_op_begin_block(pSD);
+    return SD_BLOCK_DEVICE_ERROR_NONE;
+}
+
+/* Advance the write as far as it can go without waiting: collect a finished
+DMA, send the CRC, and start the next block as soon as the card releases DO.
+One busy poll costs a single byte on the bus. */
+int sd_write_blocks_poll(sd_card_t *pSD) {
+    sd_write_op_t *op = &pSD->write_op;
+    for (;;) {
+        switch (op->state) {
+            case SD_WRITE_IDLE:
+                return SD_BLOCK_DEVICE_ERROR_PARAMETER;
+            case SD_WRITE_DATA: {
+                if (!sd_spi_transfer_is_complete(pSD)) {
+                    if (!time_reached(op->deadline))
+                        return SD_BLOCK_DEVICE_ERROR_WOULD_BLOCK;
+                    // The card holds a partial block; the busy state lets
+                    // it settle and the stop token ends a multi-block write
+                    DBG_PRINTF("%s: DMA timed out\r\n", __FUNCTION__);
+                    spi_transfer_abort(pSD->spi);
+                    op->status = SD_BLOCK_DEVICE_ERROR_WRITE;
+                    op->remaining = 0;
+                    op->deadline = make_timeout_time_ms(SD_COMMAND_TIMEOUT);
+                    op->state = SD_WRITE_BUSY;
+                    break;
+                }
+                bool ret = sd_spi_transfer_wait_complete(pSD, 0);
+                myASSERT(ret);
+                if (op->crc_sniff) op->crc = spi_transfer_crc16(pSD->spi);
+                uint8_t trailer_tx[3] = {op->crc >> 8, op->crc, SPI_FILL_CHAR};
+                uint8_t trailer_rx[3];
+                sd_spi_transfer(pSD, trailer_tx, trailer_rx, sizeof trailer_tx);
+                uint8_t response = trailer_rx[2] & SPI_DATA_RESPONSE_MASK;
+                if (response != SPI_DATA_ACCEPTED) {
+                    DBG_PRINTF("Async Block Write failed: 0x%x\r\n", response);
+                    if (SPI_DATA_CRC_ERROR == response) pSD->stats.crc_errors++;
+                    op->status = SD_BLOCK_DEVICE_ERROR_WRITE;
+                    op->remaining = 0;
+                } else {
+                    op->buffer += _block_size;
+                    --op->remaining;
+                }
+                op->deadline = make_timeout_time_ms(SD_COMMAND_TIMEOUT);
+                op->state = SD_WRITE_BUSY;
+                break;
+            }
+            case SD_WRITE_BUSY:
+                if (0x00 == sd_spi_write(pSD, SPI_FILL_CHAR)) {
+                    if (!time_reached(op->deadline))
+                        return SD_BLOCK_DEVICE_ERROR_WOULD_BLOCK;
+                    DBG_PRINTF("%s:%d: Card not ready yet\r\n", __FILE__, __LINE__);
+                    if (SD_BLOCK_DEVICE_ERROR_NONE == op->status)
+                        op->status = SD_BLOCK_DEVICE_ERROR_WRITE;
+                    op->remaining = 0;
+                    if (op->stop_sent) {  // Still busy after Stop Tran: give up
+                        op->state = SD_WRITE_IDLE;
+                        sd_clock_check(pSD, op->status);
+                        sd_release(pSD);
+                        return op->status;
+                    }
+                }
+                if (op->remaining) {
+                    sd_write_op_begin_block(pSD);
+                    break;
+                }
+                if (op->multi && !op->stop_sent) {
+                    sd_spi_write(pSD, SPI_STOP_TRAN);
+                    sd_spi_write(pSD, SPI_FILL_CHAR);  // Nbr: busy starts after one byte
+                    op->stop_sent = true;
+                    op->deadline = make_timeout_time_ms(SD_COMMAND_TIMEOUT);
+                    break;
+                }
+                op->state = SD_WRITE_IDLE;
+                int status = sd_write_status(pSD, op->status);
+                sd_clock_check(pSD, status);  // Counts toward a step-down, no retry here
+                sd_release(pSD);
+                return status;
+        }
+    }
+}
+
+enum {
+    SD_READ_IDLE,
+    SD_READ_TOKEN,  // Waiting for the card to send the start block token
+    SD_READ_DATA    // Block DMA in flight
+};
+
+int sd_read_blocks_start(sd_card_t *pSD, uint8_t *buffer,
+                         uint64_t ulSectorNumber, uint32_t ulSectorCount) {
+    if (!ulSectorCount || ulSectorNumber + ulSectorCount > pSD->sectors)
+        return SD_BLOCK_DEVICE_ERROR_PARAMETER;
+    if (pSD->m_Status & (STA_NOINIT | STA_NODISK))
+        return SD_BLOCK_DEVICE_ERROR_PARAMETER;
+    myASSERT(SD_READ_IDLE == pSD->read_op.state);
+
+    sd_acquire(pSD);
+    TRACE_PRINTF("sd_read_blocks_start(0x%p, 0x%llx, 0x%lx)\r\n", buffer,
+                 ulSectorNumber, ulSectorCount);
+    uint64_t addr;
+    if (SDCARD_V2HC == pSD->card_type) {
+        addr = ulSectorNumber;
+    } else {
+        addr = ulSectorNumber * _block_size;
+    }
+    int status = sd_cmd(pSD,
+                        ulSectorCount > 1 ? CMD18_READ_MULTIPLE_BLOCK
+                                          : CMD17_READ_SINGLE_BLOCK,
+                        addr, false, 0);
+    if (SD_BLOCK_DEVICE_ERROR_NONE != status) {
+        sd_release(pSD);
+        return status;
+    }
+    sd_read_op_t *op = &pSD->read_op;
+    op->buffer = buffer;
+    op->remaining = ulSectorCount;
+    op->multi = ulSectorCount > 1;
+    op->status = SD_BLOCK_DEVICE_ERROR_NONE;
+    op->crc_sniff = false;
+#if SD_CRC_ENABLED
+    op->crc_sniff = crc_on && pSD->spi->crc16_sniff;
+#endif
+    op->deadline = make_timeout_time_ms(SD_COMMAND_TIMEOUT);
+    op->state = SD_READ_TOKEN;
+    return SD_BLOCK_DEVICE_ERROR_NONE;
+}
+
+int sd_read_blocks_poll(sd_card_t *pSD) {
+    sd_read_op_t *op = &pSD->read_op;
+    for (;;) {
+        switch (op->state) {
+            case SD_READ_IDLE:
+                return SD_BLOCK_DEVICE_ERROR_PARAMETER;
+            case SD_READ_TOKEN: {
+                uint8_t token = sd_spi_write(pSD, SPI_FILL_CHAR);
+                if (SPI_FILL_CHAR == token) {
+                    if (!time_reached(op->deadline))
+                        return SD_BLOCK_DEVICE_ERROR_WOULD_BLOCK;
+                    DBG_PRINTF("%s: Read timeout\r\n", __FUNCTION__);
+                    op->status = SD_BLOCK_DEVICE_ERROR_NO_RESPONSE;
+                    op->remaining = 0;
+                    break;
+                }
+                if (SPI_START_BLOCK != token) {  // Data error token
+                    DBG_PRINTF("%s: Error token 0x%02x\r\n", __FUNCTION__, token);
+                    op->status = SD_BLOCK_DEVICE_ERROR_NO_RESPONSE;
+                    op->remaining = 0;
+                    break;
+                }
+                bool ret = op->crc_sniff
+                               ? spi_transfer_start_crc16(pSD->spi, NULL, op->buffer, _block_size)
+                               : sd_spi_transfer_start(pSD, NULL, op->buffer, _block_size);
+                myASSERT(ret);
+                op->deadline = make_timeout_time_ms(1000);
+                op->state = SD_READ_DATA;
+                break;
+            }
+            case SD_READ_DATA: {
+                if (!sd_spi_transfer_is_complete(pSD)) {
+                    if (!time_reached(op->deadline))
+                        return SD_BLOCK_DEVICE_ERROR_WOULD_BLOCK;
+                    DBG_PRINTF("%s: DMA timed out\r\n", __FUNCTION__);
+                    spi_transfer_abort(pSD->spi);
+                    op->status = SD_BLOCK_DEVICE_ERROR_NO_RESPONSE;
+                    op->remaining = 0;
+                    op->state = SD_READ_TOKEN;  // Finish below: CMD12 if multi
+                    break;
+                }
+                bool ret = sd_spi_transfer_wait_complete(pSD, 0);
+                myASSERT(ret);
+                uint16_t crc = op->crc_sniff ? spi_transfer_crc16(pSD->spi) : 0;
+                uint8_t crc_bytes[2];
+                sd_spi_transfer(pSD, NULL, crc_bytes, sizeof crc_bytes);
+#if SD_CRC_ENABLED
+                if (crc_on) {
+                    if (!op->crc_sniff) crc = crc16((void *)op->buffer, _block_size);
+                    if (crc != ((crc_bytes[0] << 8) | crc_bytes[1])) {
+                        DBG_PRINTF("%s: Invalid CRC\r\n", __FUNCTION__);
+                        pSD->stats.crc_errors++;
+                        op->status = SD_BLOCK_DEVICE_ERROR_CRC;
+                        op->remaining = 0;
+                    }
+                }
+#endif
+                if (SD_BLOCK_DEVICE_ERROR_NONE == op->status) {
+                    op->buffer += _block_size;
+                    --op->remaining;
+                }
+                op->deadline = make_timeout_time_ms(SD_COMMAND_TIMEOUT);
+                op->state = SD_READ_TOKEN;
+                break;
+            }
+        }
+        if (SD_READ_TOKEN == op->state && !op->remaining) {
+            int status = op->status;
+            if (op->multi) {
+                int rc = sd_cmd(pSD, CMD12_STOP_TRANSMISSION, 0x0, false, 0);
+                if (!status) status = rc;
+            }
+            op->state = SD_READ_IDLE;
+            sd_clock_check(pSD, status);  // Counts toward a step-down, no retry here
+            sd_release(pSD);
+            return status;
+        }
+    }
+}
+
 static int sd_init_medium(sd_card_t *pSD) {
     int32_t status = SD_BLOCK_DEVICE_ERROR_NONE;
     uint32_t response, arg;
@@ -1224,12 +1688,12 @@ static int sd_init(sd_card_t *pSD) {
         sd_unlock(pSD);
         return pSD->m_Status;
     }
-    // Set SCK for data transfer
-    sd_spi_go_high_frequency(pSD);
-
     // The card is now initialized
     pSD->m_Status &= ~STA_NOINIT;
 
+    // Set SCK for data transfer
+    sd_negotiate_clock(pSD);
+
     sd_spi_release(pSD);
     sd_unlock(pSD);
 
@@ -21,6 +21,7 @@ specific language governing permissions and limitations under the License.
 //
 #include "hardware/gpio.h"
 #include "pico/mutex.h"
+#include "pico/time.h"
 //
 #include "ff.h"
 //
@@ -32,6 +33,62 @@ extern "C" {
 
 typedef struct sd_card_t sd_card_t;
 
+// Counters kept by the driver and by glue.c. They only ever count up; zero
+// them to start a new measurement.
+typedef struct {
+    uint32_t single_block_writes;  // CMD24 transactions
+    uint32_t multi_block_writes;   // CMD25 transactions
+    uint32_t blocks_written;       // Total 512-byte blocks in both
+    uint32_t commands[64];         // Command frames sent, by index (an ACMD is CMD55 + its index)
+    uint32_t command_retries;      // Frames resent after no response
+    uint32_t transfer_retries;     // Block reads/writes repeated after a CRC error or timeout
+    uint32_t crc_errors;           // R1 COM_CRC_ERROR, data CRC mismatches, CRC-rejected writes
+    uint64_t wait_ready_us;        // Spent busy-waiting in sd_wait_ready()
+    uint64_t wait_token_us;        // Spent busy-waiting in sd_wait_token()
+    // Kept by glue.c
+    uint32_t disk_reads;           // disk_read() calls
+    uint32_t disk_writes;          // disk_write() calls
+    uint32_t async_reads;          // Requests through the disk_async.h queue
+    uint32_t async_writes;
+    uint64_t sectors_read;         // By both paths
+    uint64_t sectors_written;
+} sd_card_stats_t;
+
+// State of a read begun by sd_read_blocks_start(). Internal to sd_card.c.
+typedef struct {
+    uint8_t *buffer;        // Next block to receive
+    uint32_t remaining;
+    bool multi;             // CMD18: needs CMD12 at the end
+    bool crc_sniff;
+    int state;
+    int status;
+    absolute_time_t deadline;
+} sd_read_op_t;
+
+/* When to follow a write with CMD13 (SEND_STATUS). The data response token
+already reports CRC and write errors for every block; CMD13 adds the
+card-level error bits (ECC failure, WP violation, ...), which stay latched in
+the card status until read. Deferring it therefore loses no errors as long as
+sd_sync() runs before the data is trusted, which CTRL_SYNC and unmount do. */
+typedef enum {
+    SD_STATUS_CHECK_EVERY_WRITE = 0,  // Default, as in the original driver
+    SD_STATUS_CHECK_EVERY_N,          // After every status_check_interval writes
+    SD_STATUS_CHECK_ON_SYNC           // Only after a rejected write, and in sd_sync()
+} sd_status_check_t;
+
+// State of a write begun by sd_write_blocks_start(). Internal to sd_card.c.
+typedef struct {
+    const uint8_t *buffer;  // Next block to send
+    uint32_t remaining;     // Blocks not yet accepted by the card
+    bool multi;             // CMD25: needs the Stop Tran token at the end
+    bool stop_sent;
+    int state;
+    int status;             // First error seen, reported when the write ends
+    uint16_t crc;
+    bool crc_sniff;         // crc comes from the DMA sniffer when the block ends
+    absolute_time_t deadline;
+} sd_write_op_t;
+
 // "Class" representing SD Cards
 struct sd_card_t {
     const char *pcName;
@@ -54,6 +111,17 @@ struct sd_card_t {
     mutex_t mutex;
     FATFS fatfs;
     bool mounted;
+    sd_card_stats_t stats;
+    sd_write_op_t write_op;
+    sd_read_op_t read_op;
+    sd_status_check_t status_check;
+    uint32_t status_check_interval;  // For SD_STATUS_CHECK_EVERY_N
+    uint32_t writes_since_status;
+    // SCK negotiated at init, at most spi->baud_rate (which acts as a ceiling)
+    uint baud_rate;             // Actual frequency, after divider rounding
+    uint8_t clock_step;         // Index into the driver's clock ladder
+    uint8_t bus_errors;         // Consecutive CRC/timeout errors at this clock
+    uint32_t clock_step_downs;  // Times the clock was lowered after errors
 
     int (*init)(sd_card_t *sd_card_p);
     int (*write_blocks)(sd_card_t *sd_card_p, const uint8_t *buffer,
@@ -89,6 +157,26 @@ struct sd_card_t {
 
 bool sd_card_detect(sd_card_t *pSD);
 uint64_t sd_sectors(sd_card_t *pSD);
+uint32_t sd_allocation_unit(sd_card_t *pSD);
+
+/* Non-blocking form of write_blocks. sd_write_blocks_start() sends the write
+command and starts the DMA for the first block, then returns. Call
+sd_write_blocks_poll() until it returns something other than
+SD_BLOCK_DEVICE_ERROR_WOULD_BLOCK; that is the final status. The card and its
+SPI stay acquired in between, so nothing else may use them until the write
+ends, and buffer must stay valid and unmodified until then. */
+int sd_write_blocks_start(sd_card_t *pSD, const uint8_t *buffer,
+                          uint64_t ulSectorNumber, uint32_t blockCnt);
+int sd_write_blocks_poll(sd_card_t *pSD);
+/* The same for reads (CMD17/CMD18): each poll waits for at most one byte of
+the start token, and blocks arrive by DMA between polls. */
+int sd_read_blocks_start(sd_card_t *pSD, uint8_t *buffer,
+                         uint64_t ulSectorNumber, uint32_t ulSectorCount);
+int sd_read_blocks_poll(sd_card_t *pSD);
+
+/* Run the CMD13 skipped by the status check policy, if any. Returns the
+first error the card reports. */
+int sd_sync(sd_card_t *pSD);
 
 bool sd_init_driver();
 bool sd_card_detect(sd_card_t *sd_card_p);
@@ -19,6 +19,7 @@ specific language governing permissions and limitations under the License.
 //
 #include "hardware/gpio.h"
 //
+#include "crc.h"
 #include "my_debug.h"
 #include "sd_card.h"
 #include "sd_spi.h"
@@ -91,16 +92,37 @@ bool sd_spi_transfer(sd_card_t *pSD, const uint8_t *tx, uint8_t *rx,
     return spi_transfer(pSD->spi, tx, rx, length);
 }
 
+bool sd_spi_transfer_start(sd_card_t *pSD, const uint8_t *tx, uint8_t *rx,
+                           size_t length) {
+    return spi_transfer_start(pSD->spi, tx, rx, length);
+}
+
+bool sd_spi_transfer_wait_complete(sd_card_t *pSD, uint32_t timeout_ms) {
+    return spi_transfer_wait_complete(pSD->spi, timeout_ms);
+}
+
+bool sd_spi_transfer_is_complete(sd_card_t *pSD) {
+    return spi_transfer_is_complete(pSD->spi);
+}
+
+bool sd_spi_transfer_crc16(sd_card_t *pSD, const uint8_t *tx, uint8_t *rx,
+                           size_t length, uint16_t *crc) {
+    if (!pSD->spi->crc16_sniff) {
+        bool rc = sd_spi_transfer(pSD, tx, rx, length);
+        *crc = crc16((const char *)(rx ? rx : tx), length);
+        return rc;
+    }
+    if (!spi_transfer_start_crc16(pSD->spi, tx, rx, length)) return false;
+    bool rc = spi_transfer_wait_complete(pSD->spi, 1000);
+    *crc = spi_transfer_crc16(pSD->spi);
+    return rc;
+}
+
 uint8_t sd_spi_write(sd_card_t *pSD, const uint8_t value) {
     // TRACE_PRINTF("%s\n", __FUNCTION__);
     uint8_t received = SPI_FILL_CHAR;
-#if 0
-    int num = spi_write_read_blocking(pSD->spi->hw_inst, &value, &received, 1);
-    myASSERT(1 == num);
-#else
     bool success = spi_transfer(pSD->spi, &value, &received, 1);
     myASSERT(success);
-#endif
     return received;
 }
 
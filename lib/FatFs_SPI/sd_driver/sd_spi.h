@@ -21,6 +21,13 @@ specific language governing permissions and limitations under the License.
 /* Transfer tx to SPI while receiving SPI to rx. 
 tx or rx can be NULL if not important. */
 bool sd_spi_transfer(sd_card_t *pSD, const uint8_t *tx, uint8_t *rx, size_t length);
+/* Split form of sd_spi_transfer: the CPU is free between the two calls. */
+bool sd_spi_transfer_start(sd_card_t *pSD, const uint8_t *tx, uint8_t *rx, size_t length);
+bool sd_spi_transfer_wait_complete(sd_card_t *pSD, uint32_t timeout_ms);
+bool sd_spi_transfer_is_complete(sd_card_t *pSD);
+/* sd_spi_transfer() that also returns the CRC16 of the data block in *crc:
+from the DMA sniffer when it is usable, otherwise from the tables. */
+bool sd_spi_transfer_crc16(sd_card_t *pSD, const uint8_t *tx, uint8_t *rx, size_t length, uint16_t *crc);
 uint8_t sd_spi_write(sd_card_t *pSD, const uint8_t value);
 void sd_spi_deselect_pulse(sd_card_t *pSD);
 void sd_spi_acquire(sd_card_t *pSD);
@@ -21,8 +21,10 @@ specific language governing permissions and limitations under the License.
 //
 #include "my_debug.h"
 #include "hw_config.h"
+#include "crc.h"
 //
 #include "spi.h"
+#include "sd_trace.h"
 
 static bool irqChannel1 = false;
 static bool irqShared = true;
@@ -54,15 +56,23 @@ void set_spi_dma_irq_channel(bool useChannel1, bool shared) {
     irqShared = shared;
 }
 
-// SPI Transfer: Read & Write (simultaneously) on SPI bus
-//   If the data that will be received is not important, pass NULL as rx.
-//   If the data that will be transmitted is not important,
-//     pass NULL as tx and then the SPI_FILL_CHAR is sent out as each data
-//     element.
-bool spi_transfer(spi_t *spi_p, const uint8_t *tx, uint8_t *rx, size_t length) {
-    // assert(512 == length || 1 == length);
+// Short transfers: drive the PL022 FIFOs directly
+static bool spi_transfer_polled(spi_t *spi_p, const uint8_t *tx, uint8_t *rx, size_t length) {
+    int num;
+    if (tx && rx)
+        num = spi_write_read_blocking(spi_p->hw_inst, tx, rx, length);
+    else if (tx)
+        num = spi_write_blocking(spi_p->hw_inst, tx, length);
+    else
+        num = spi_read_blocking(spi_p->hw_inst, SPI_FILL_CHAR, rx, length);
+    return (size_t)num == length;
+}
+
+// Start a DMA transfer and return without waiting for it.
+//   The CPU is free until spi_transfer_wait_complete(); tx and rx must stay
+//   valid (and tx unmodified) until then. Always uses DMA, whatever the length.
+bool spi_transfer_start(spi_t *spi_p, const uint8_t *tx, uint8_t *rx, size_t length) {
     assert(tx || rx);
-    // assert(!(tx && rx));
 
     // tx write increment is already false
     if (tx) {
@@ -106,15 +116,22 @@ bool spi_transfer(spi_t *spi_p, const uint8_t *tx, uint8_t *rx, size_t length) {
             assert(false);
     }
     sem_reset(&spi_p->sem, 0);
+    spi_p->dma_transfers++;
+    spi_p->dma_bytes += length;
 
     // start them exactly simultaneously to avoid races (in extreme cases
     // the FIFO could overflow)
     dma_start_channel_mask((1u << spi_p->tx_dma) | (1u << spi_p->rx_dma));
+    return true;
+}
 
+// Wait for the transfer begun by spi_transfer_start()
+bool spi_transfer_wait_complete(spi_t *spi_p, uint32_t timeout_ms) {
     /* Wait until master completes transfer or time out has occured. */
-    uint32_t timeOut = 1000; /* Timeout 1 sec */
+    TRACE_BEGIN(TRACE_EV_SPI_DMA_WAIT);
     bool rc = sem_acquire_timeout_ms(
-        &spi_p->sem, timeOut);  // Wait for notification from ISR
+        &spi_p->sem, timeout_ms);  // Wait for notification from ISR
+    TRACE_END(TRACE_EV_SPI_DMA_WAIT);
     if (!rc) {
         // If the timeout is reached the function will return false
         DBG_PRINTF("Notification wait timed out in %s\n", __FUNCTION__);
@@ -131,6 +148,82 @@ bool spi_transfer(spi_t *spi_p, const uint8_t *tx, uint8_t *rx, size_t length) {
     return true;
 }
 
+// True once the transfer begun by spi_transfer_start() has finished, so a
+// following spi_transfer_wait_complete() will not block. Never blocks itself.
+bool spi_transfer_is_complete(spi_t *spi_p) {
+    return sem_available(&spi_p->sem) > 0;
+}
+
+// Give up on the transfer begun by spi_transfer_start(): stop both channels,
+// drop whatever is left in the receive FIFO and forget any completion that
+// raced with the abort, so the next transfer starts clean.
+void spi_transfer_abort(spi_t *spi_p) {
+    dma_channel_abort(spi_p->tx_dma);
+    dma_channel_abort(spi_p->rx_dma);
+    dma_sniffer_disable();
+    while (spi_is_busy(spi_p->hw_inst)) tight_loop_contents();
+    while (spi_is_readable(spi_p->hw_inst))
+        (void)spi_get_hw(spi_p->hw_inst)->dr;
+    sem_reset(&spi_p->sem, 0);
+}
+
+// spi_transfer_start() with the DMA sniffer computing CRC16-CCITT over the
+//   bytes received (if rx is given) or else the bytes sent. Read the result
+//   with spi_transfer_crc16() after spi_transfer_wait_complete(). There is
+//   one sniffer for all DMA channels; only the SD driver uses it.
+bool spi_transfer_start_crc16(spi_t *spi_p, const uint8_t *tx, uint8_t *rx, size_t length) {
+    uint channel = rx ? spi_p->rx_dma : spi_p->tx_dma;
+    dma_channel_config *cfg = rx ? &spi_p->rx_dma_cfg : &spi_p->tx_dma_cfg;
+    dma_sniffer_enable(channel, DMA_SNIFF_CTRL_CALC_VALUE_CRC16, false);
+    dma_sniffer_set_data_accumulator(0);
+    channel_config_set_sniff_enable(cfg, true);
+    bool rc = spi_transfer_start(spi_p, tx, rx, length);
+    channel_config_set_sniff_enable(cfg, false);  // Applied at configure time
+    return rc;
+}
+
+uint16_t spi_transfer_crc16(spi_t *spi_p) {
+    (void)spi_p;
+    uint16_t crc = dma_sniffer_get_data_accumulator();
+    dma_sniffer_disable();
+    return crc;
+}
+
+// Run a memory-to-memory copy through the sniffer and compare with crc16()
+static bool crc16_sniff_self_test(spi_t *spi_p) {
+    static uint8_t src[64], dst[64];
+    for (size_t i = 0; i < sizeof src; i++) src[i] = i * 37 + 11;
+    dma_channel_config cfg = dma_channel_get_default_config(spi_p->tx_dma);
+    channel_config_set_transfer_data_size(&cfg, DMA_SIZE_8);
+    channel_config_set_sniff_enable(&cfg, true);
+    dma_sniffer_enable(spi_p->tx_dma, DMA_SNIFF_CTRL_CALC_VALUE_CRC16, false);
+    dma_sniffer_set_data_accumulator(0);
+    dma_channel_configure(spi_p->tx_dma, &cfg, dst, src, sizeof src, true);
+    dma_channel_wait_for_finish_blocking(spi_p->tx_dma);
+    uint16_t crc = spi_transfer_crc16(spi_p);
+    return crc == crc16((const char *)src, sizeof src);
+}
+
+// SPI Transfer: Read & Write (simultaneously) on SPI bus
+//   If the data that will be received is not important, pass NULL as rx.
+//   If the data that will be transmitted is not important,
+//     pass NULL as tx and then the SPI_FILL_CHAR is sent out as each data
+//     element.
+bool spi_transfer(spi_t *spi_p, const uint8_t *tx, uint8_t *rx, size_t length) {
+    // assert(512 == length || 1 == length);
+    assert(tx || rx);
+    // assert(!(tx && rx));
+
+    if (length < spi_p->dma_threshold) {
+        spi_p->polled_transfers++;
+        spi_p->polled_bytes += length;
+        return spi_transfer_polled(spi_p, tx, rx, length);
+    }
+
+    if (!spi_transfer_start(spi_p, tx, rx, length)) return false;
+    return spi_transfer_wait_complete(spi_p, 1000); /* Timeout 1 sec */
+}
+
 void spi_lock(spi_t *spi_p) {
     assert(mutex_is_initialized(&spi_p->mutex));
     mutex_enter_blocking(&spi_p->mutex);
@@ -153,6 +246,8 @@ bool my_spi_init(spi_t *spi_p) {
         // Default:
         if (!spi_p->baud_rate)
             spi_p->baud_rate = 10 * 1000 * 1000;
+        if (!spi_p->dma_threshold)
+            spi_p->dma_threshold = SPI_DMA_THRESHOLD;
         // For the IRQ notification:
         sem_init(&spi_p->sem, 0, 1);
 
@@ -241,6 +336,11 @@ bool my_spi_init(spi_t *spi_p) {
             irq_set_exclusive_handler(spi_p->DMA_IRQ_num, *spi_irq_handler_p);
         }
         irq_set_enabled(spi_p->DMA_IRQ_num, true);
+#if SPI_CRC16_SNIFF
+        spi_p->crc16_sniff = crc16_sniff_self_test(spi_p);
+        if (!spi_p->crc16_sniff)
+            DBG_PRINTF("DMA sniffer CRC16 mismatch: using tables\n");
+#endif
         LED_INIT();
         spi_p->initialized = true;
         spi_unlock(spi_p);
@@ -27,6 +27,21 @@ specific language governing permissions and limitations under the License.
 
 #define SPI_FILL_CHAR (0xFF)
 
+/* Let the DMA sniffer compute the CRC16 of SD data blocks while they are
+transferred. my_spi_init() checks the sniffer against crc16() once and falls
+back to the table if they disagree. */
+#ifndef SPI_CRC16_SNIFF
+#  define SPI_CRC16_SNIFF 1
+#endif
+
+/* Default for spi_t.dma_threshold. Token polling, R1 responses, command
+packets and CRCs are all shorter than this, and for them setting up two DMA
+channels and waiting for the completion interrupt costs more than the
+transfer itself. */
+#ifndef SPI_DMA_THRESHOLD
+#  define SPI_DMA_THRESHOLD 32
+#endif
+
 // "Class" representing SPIs
 typedef struct {
     // SPI HW
@@ -36,6 +51,9 @@ typedef struct {
     uint sck_gpio;
     uint baud_rate;
     uint DMA_IRQ_num; // DMA_IRQ_0 or DMA_IRQ_1
+    // Transfers shorter than this many bytes poll the PL022 FIFOs instead of
+    // using DMA. 0 selects SPI_DMA_THRESHOLD; 1 always uses DMA.
+    uint dma_threshold;
 
     // Drive strength levels for GPIO outputs.
     // enum gpio_drive_strength { GPIO_DRIVE_STRENGTH_2MA = 0, GPIO_DRIVE_STRENGTH_4MA = 1, GPIO_DRIVE_STRENGTH_8MA = 2,
@@ -51,8 +69,14 @@ typedef struct {
     dma_channel_config rx_dma_cfg;
     irq_handler_t dma_isr; // Ignored: no longer used
     bool initialized;  
+    bool crc16_sniff;  // Sniffer passed the self-test: spi_transfer_start_crc16() is usable
     semaphore_t sem;
     mutex_t mutex;    
+    // Counters: they only ever count up; zero them to start a new measurement
+    uint32_t dma_transfers;
+    uint64_t dma_bytes;
+    uint32_t polled_transfers;  // Short transfers below dma_threshold
+    uint64_t polled_bytes;
 } spi_t;
 
 #ifdef __cplusplus
@@ -60,6 +84,12 @@ extern "C" {
 #endif
   
 bool __not_in_flash_func(spi_transfer)(spi_t *pSPI, const uint8_t *tx, uint8_t *rx, size_t length);  
+bool spi_transfer_start(spi_t *pSPI, const uint8_t *tx, uint8_t *rx, size_t length);
+bool spi_transfer_wait_complete(spi_t *pSPI, uint32_t timeout_ms);
+bool spi_transfer_is_complete(spi_t *pSPI);
+void spi_transfer_abort(spi_t *pSPI);
+bool spi_transfer_start_crc16(spi_t *pSPI, const uint8_t *tx, uint8_t *rx, size_t length);
+uint16_t spi_transfer_crc16(spi_t *pSPI);
 void spi_lock(spi_t *pSPI);
 void spi_unlock(spi_t *pSPI);
 bool my_spi_init(spi_t *pSPI);
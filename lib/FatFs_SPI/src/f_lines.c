@@ -0,0 +1,84 @@
+/* f_lines.c
+Block-buffered line reader. See f_lines.h.
+*/
+#include <stdint.h>
+#include <string.h>
+//
+#include "f_lines.h"
+
+// Find '\n' in [p, end). Four bytes per step once p is word aligned: a byte
+// of (w ^ 0x0A0A0A0A) is zero exactly where w holds a newline.
+static const char *find_newline(const char *p, const char *end) {
+    while (p < end && ((uintptr_t)p & 3)) {
+        if ('\n' == *p) return p;
+        ++p;
+    }
+    while (end - p >= 4) {
+        uint32_t w;
+        memcpy(&w, p, sizeof w);  // Aligned: compiles to a single load
+        w ^= 0x0A0A0A0Au;
+        if ((w - 0x01010101u) & ~w & 0x80808080u) break;
+        p += 4;
+    }
+    while (p < end) {
+        if ('\n' == *p) return p;
+        ++p;
+    }
+    return NULL;
+}
+
+void f_lines_init(f_lines_t *lr, FIL *fp, void *buf, size_t size) {
+    lr->fp = fp;
+    lr->buf = buf;
+    lr->size = size;
+    lr->pos = 0;
+    lr->len = 0;
+    lr->eof = false;
+    lr->fr = FR_OK;
+}
+
+// Move the unread tail to the front and top the buffer up. The request is
+// rounded down to whole sectors so the file position stays sector aligned
+// and FatFs reads straight into buf instead of through its sector window.
+static void refill(f_lines_t *lr) {
+    size_t tail = lr->len - lr->pos;
+    if (lr->pos) {
+        memmove(lr->buf, lr->buf + lr->pos, tail);
+        lr->pos = 0;
+        lr->len = tail;
+    }
+    size_t room = lr->size - lr->len;
+    if (room >= 512 && 0 == f_tell(lr->fp) % 512) room &= ~(size_t)511;
+    UINT br = 0;
+    FRESULT fr = f_read(lr->fp, lr->buf + lr->len, room, &br);
+    if (FR_OK != fr) {
+        lr->fr = fr;
+        lr->eof = true;
+    } else if (br < room) {
+        lr->eof = true;
+    }
+    lr->len += br;
+}
+
+const char *f_lines_next(f_lines_t *lr, size_t *len) {
+    for (;;) {
+        const char *start = lr->buf + lr->pos;
+        const char *end = lr->buf + lr->len;
+        const char *nl = find_newline(start, end);
+        if (nl) {
+            *len = nl + 1 - start;
+            lr->pos += *len;
+            return start;
+        }
+        // No newline in what is buffered: a full buffer or the end of the
+        // file ends the line here, otherwise read more
+        if (lr->eof || (0 == lr->pos && lr->len == lr->size)) {
+            *len = end - start;
+            lr->pos = lr->len;
+            return *len ? start : NULL;
+        }
+        refill(lr);
+    }
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,131 @@
+/* f_stream.c
+Streaming reads over the fast-seek link map. See f_stream.h.
+*/
+#include <stdbool.h>
+//
+#include "pico/stdlib.h"
+//
+#include "disk_async.h"
+#include "f_stream.h"
+
+typedef struct {
+    BYTE *data;
+    size_t len;               // File bytes in this chunk
+    volatile bool busy;
+    DRESULT result;
+} chunk_t;
+
+// Where the next raw read comes from
+typedef struct {
+    FATFS *fs;
+    const DWORD *frag;        // Current link map entry: {clusters, first cluster}
+    LBA_t skip;               // Sectors of *frag already queued
+    FSIZE_t queued;           // File offset of the next read
+    FSIZE_t end;
+    size_t half;
+} cursor_t;
+
+static void chunk_done(DRESULT result, void *ctx) {
+    chunk_t *c = ctx;
+    c->result = result;
+    c->busy = false;
+}
+
+// Queue the next piece of the file into c: at most half the buffer, and never
+// across a fragment boundary, so it is one CMD18 of contiguous sectors.
+// Returns false at the end of the file.
+static bool issue(cursor_t *cur, chunk_t *c) {
+    if (cur->queued >= cur->end || !cur->frag[0]) return false;
+    FATFS *fs = cur->fs;
+    LBA_t frag_sects = (LBA_t)cur->frag[0] * fs->csize;
+    UINT n = cur->half / FF_MAX_SS;
+    if (n > frag_sects - cur->skip) n = frag_sects - cur->skip;
+    FSIZE_t left = cur->end - cur->queued;
+    if ((FSIZE_t)n * FF_MAX_SS >= left) {
+        n = (left + FF_MAX_SS - 1) / FF_MAX_SS;
+        c->len = left;
+    } else {
+        c->len = (size_t)n * FF_MAX_SS;
+    }
+    LBA_t lba = fs->database + (LBA_t)fs->csize * (cur->frag[1] - 2) + cur->skip;
+    c->busy = true;
+    c->result = RES_OK;
+    while (RES_NOTRDY ==
+           disk_read_async(fs->pdrv, c->data, lba, n, chunk_done, c))
+        disk_async_poll();
+    cur->queued += c->len;
+    cur->skip += n;
+    if (cur->skip == frag_sects) {
+        cur->frag += 2;
+        cur->skip = 0;
+    }
+    return true;
+}
+
+// Plain f_read loop, for files the raw path cannot handle
+static FRESULT stream_fread(FIL *fp, BYTE *buf, size_t half,
+                            f_stream_sink_t sink, void *ctx) {
+    for (;;) {
+        UINT br = 0;
+        FRESULT fr = f_read(fp, buf, half, &br);
+        if (FR_OK != fr) return fr;
+        if (!br || !sink(buf, br, ctx) || br < half) return FR_OK;
+    }
+}
+
+FRESULT f_stream(FIL *fp, void *buf, size_t size, f_stream_sink_t sink,
+                 void *ctx) {
+    size_t half = (size / 2) & ~(size_t)(FF_MAX_SS - 1);
+    if (!fp || !buf || !sink || !half) return FR_INVALID_PARAMETER;
+    if ((fp->flag & FA_WRITE) || f_tell(fp) % FF_MAX_SS)
+        return stream_fread(fp, buf, half, sink, ctx);
+
+    DWORD clmt[2 + 2 * F_STREAM_FRAGMENTS];
+    clmt[0] = sizeof clmt / sizeof clmt[0];
+    fp->cltbl = clmt;
+    FRESULT fr = f_lseek(fp, CREATE_LINKMAP);
+    fp->cltbl = NULL;
+    if (FR_NOT_ENOUGH_CORE == fr)  // Too fragmented for the table
+        return stream_fread(fp, buf, half, sink, ctx);
+    if (FR_OK != fr) return fr;
+
+    cursor_t cur = {.fs = fp->obj.fs,
+                    .frag = &clmt[1],
+                    .skip = f_tell(fp) / FF_MAX_SS,
+                    .queued = f_tell(fp),
+                    .end = f_size(fp),
+                    .half = half};
+    // Walk the link map to the current position
+    while (cur.frag[0] && cur.skip >= (LBA_t)cur.frag[0] * cur.fs->csize) {
+        cur.skip -= (LBA_t)cur.frag[0] * cur.fs->csize;
+        cur.frag += 2;
+    }
+
+    chunk_t chunks[2] = {{.data = buf}, {.data = (BYTE *)buf + half}};
+    FSIZE_t done = f_tell(fp);
+    unsigned i = 0;
+    bool more = issue(&cur, &chunks[0]);
+    while (more) {
+        chunk_t *c = &chunks[i];
+        while (c->busy) {
+            disk_async_poll();
+            tight_loop_contents();
+        }
+        if (RES_OK != c->result) {
+            fr = FR_DISK_ERR;
+            break;
+        }
+        // Refill the other half while the sink works on this one
+        more = issue(&cur, &chunks[i ^ 1]);
+        done += c->len;
+        if (!sink(c->data, c->len, ctx)) break;
+        i ^= 1;
+    }
+    // The buffer must not be written after we return. A chunk that fails
+    // after the sink stopped is not ours to report.
+    disk_async_flush();
+    FRESULT fr2 = f_lseek(fp, done);
+    return FR_OK != fr ? fr : fr2;
+}
+
+/* [] END OF FILE */
@@ -21,13 +21,17 @@ specific language governing permissions and limitations under the License.
 /*-----------------------------------------------------------------------*/
 #include <stdio.h>
 //
+#include "pico/stdlib.h"
+//
 #include "ff.h" /* Obtains integer types */
 //
 #include "diskio.h" /* Declarations of disk functions */
 //
+#include "disk_async.h"
 #include "hw_config.h"
 #include "my_debug.h"
 #include "sd_card.h"
+#include "sd_trace.h"
 
 #define TRACE_PRINTF(fmt, args...)
 //#define TRACE_PRINTF printf  // task_printf
@@ -86,6 +90,106 @@ static int sdrc2dresult(int sd_rc) {
     }
 }
 
+/*-----------------------------------------------------------------------*/
+/* Asynchronous Transfer Queue                                           */
+/*-----------------------------------------------------------------------*/
+
+typedef struct {
+    BYTE pdrv;
+    bool read;
+    BYTE *buff;  // const for writes
+    LBA_t sector;
+    UINT count;
+    disk_async_callback_t callback;
+    void *ctx;
+} disk_async_req_t;
+
+static disk_async_req_t queue[DISK_ASYNC_QUEUE_LEN];
+static UINT q_head, q_count;  // q_head is the oldest request
+static bool q_active;         // queue[q_head] has been started on the card
+
+UINT disk_async_pending(void) { return q_count; }
+
+static DRESULT queue_request(BYTE pdrv, bool read, BYTE *buff, LBA_t sector,
+                             UINT count, disk_async_callback_t callback,
+                             void *ctx) {
+    if (!sd_get_by_num(pdrv) || !count) return RES_PARERR;
+    if (q_count == DISK_ASYNC_QUEUE_LEN) return RES_NOTRDY;
+    disk_async_req_t *req = &queue[(q_head + q_count) % DISK_ASYNC_QUEUE_LEN];
+    req->pdrv = pdrv;
+    req->read = read;
+    req->buff = buff;
+    req->sector = sector;
+    req->count = count;
+    req->callback = callback;
+    req->ctx = ctx;
+    q_count++;
+    sd_card_stats_t *st = &sd_get_by_num(pdrv)->stats;
+    if (read) {
+        st->async_reads++;
+        st->sectors_read += count;
+    } else {
+        st->async_writes++;
+        st->sectors_written += count;
+    }
+    disk_async_poll();  // Start it now if the card is idle
+    return RES_OK;
+}
+
+DRESULT disk_write_async(BYTE pdrv, const BYTE *buff, LBA_t sector, UINT count,
+                         disk_async_callback_t callback, void *ctx) {
+    TRACE_PRINTF(">>> %s\n", __FUNCTION__);
+    return queue_request(pdrv, false, (BYTE *)buff, sector, count, callback,
+                         ctx);
+}
+
+DRESULT disk_read_async(BYTE pdrv, BYTE *buff, LBA_t sector, UINT count,
+                        disk_async_callback_t callback, void *ctx) {
+    TRACE_PRINTF(">>> %s\n", __FUNCTION__);
+    return queue_request(pdrv, true, buff, sector, count, callback, ctx);
+}
+
+static void complete_head(int rc) {
+    disk_async_req_t req = queue[q_head];
+    q_head = (q_head + 1) % DISK_ASYNC_QUEUE_LEN;
+    q_count--;
+    q_active = false;
+    TRACE_END(TRACE_EV_DISK_ASYNC);
+    // The result belongs to this request alone: only its callback hears it.
+    // The callback may queue the next transfer.
+    if (req.callback) req.callback(sdrc2dresult(rc), req.ctx);
+}
+
+void disk_async_poll(void) {
+    while (q_count) {
+        disk_async_req_t *req = &queue[q_head];
+        sd_card_t *p_sd = sd_get_by_num(req->pdrv);
+        int rc;
+        if (!q_active) {
+            TRACE_BEGIN(TRACE_EV_DISK_ASYNC);
+            rc = req->read ? sd_read_blocks_start(p_sd, req->buff, req->sector,
+                                                  req->count)
+                           : sd_write_blocks_start(p_sd, req->buff, req->sector,
+                                                   req->count);
+            if (SD_BLOCK_DEVICE_ERROR_NONE != rc) {
+                complete_head(rc);
+                continue;
+            }
+            q_active = true;
+        }
+        rc = req->read ? sd_read_blocks_poll(p_sd) : sd_write_blocks_poll(p_sd);
+        if (SD_BLOCK_DEVICE_ERROR_WOULD_BLOCK == rc) return;
+        complete_head(rc);
+    }
+}
+
+void disk_async_flush(void) {
+    while (q_count) {
+        disk_async_poll();
+        tight_loop_contents();
+    }
+}
+
 /*-----------------------------------------------------------------------*/
 /* Read Sector(s)                                                        */
 /*-----------------------------------------------------------------------*/
@@ -98,7 +202,12 @@ DRESULT disk_read(BYTE pdrv,  /* Physical drive nmuber to identify the drive */
     TRACE_PRINTF(">>> %s\n", __FUNCTION__);
     sd_card_t *p_sd = sd_get_by_num(pdrv);
     if (!p_sd) return RES_PARERR;
+    disk_async_flush();  // FatFs must see the queued data
+    p_sd->stats.disk_reads++;
+    p_sd->stats.sectors_read += count;
+    TRACE_BEGIN(TRACE_EV_DISK_READ);
     int rc = p_sd->read_blocks(p_sd, buff, sector, count);
+    TRACE_END(TRACE_EV_DISK_READ);
     return sdrc2dresult(rc);
 }
 
@@ -116,7 +225,12 @@ DRESULT disk_write(BYTE pdrv, /* Physical drive nmuber to identify the drive */
     TRACE_PRINTF(">>> %s\n", __FUNCTION__);
     sd_card_t *p_sd = sd_get_by_num(pdrv);
     if (!p_sd) return RES_PARERR;
+    disk_async_flush();  // Keep writes in submission order
+    p_sd->stats.disk_writes++;
+    p_sd->stats.sectors_written += count;
+    TRACE_BEGIN(TRACE_EV_DISK_WRITE);
     int rc = p_sd->write_blocks(p_sd, buff, sector, count);
+    TRACE_END(TRACE_EV_DISK_WRITE);
     return sdrc2dresult(rc);
 }
 
@@ -133,6 +247,7 @@ DRESULT disk_ioctl(BYTE pdrv, /* Physical drive nmuber (0..) */
     TRACE_PRINTF(">>> %s\n", __FUNCTION__);
     sd_card_t *p_sd = sd_get_by_num(pdrv);
     if (!p_sd) return RES_PARERR;
+    disk_async_flush();
     switch (cmd) {
         case GET_SECTOR_COUNT: {  // Retrieves number of available sectors, the
                                   // largest allowable LBA + 1, on the drive
@@ -156,12 +271,16 @@ DRESULT disk_ioctl(BYTE pdrv, /* Physical drive nmuber (0..) */
                                 // f_mkfs function and it attempts to align data
                                 // area on the erase block boundary. It is
                                 // required when FF_USE_MKFS == 1.
-            static DWORD bs = 1;
-            *(DWORD *)buff = bs;
+            // The SD allocation unit, so f_mkfs puts the data area (and
+            // with it every cluster) on AU boundaries
+            DWORD bs = sd_allocation_unit(p_sd);
+            *(DWORD *)buff = bs ? bs : 1;
             return RES_OK;
         }
         case CTRL_SYNC:
-            return RES_OK;
+            // Queued writes are drained above; run any CMD13 deferred by
+            // the status check policy so latched write errors surface here
+            return sdrc2dresult(sd_sync(p_sd));
         default:
             return RES_PARERR;
     }
@@ -0,0 +1,180 @@
+/* storage_bench.c
+Storage benchmark over FatFs and the card driver. See storage_bench.h.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+//
+#include "pico/stdlib.h"
+//
+#include "ff.h"
+#include "diskio.h"
+#include "hw_config.h"
+#include "sd_card.h"
+#include "storage_bench.h"
+
+static int cmp_u32(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+// Sort the latencies and fill in p50, p99 and max
+static void bench_percentiles(bench_row_t *row, uint32_t *lat, uint32_t n) {
+    qsort(lat, n, sizeof lat[0], cmp_u32);
+    row->n = n;
+    row->p50_us = lat[(n - 1) / 2];
+    row->p99_us = lat[(n * 99 + 99) / 100 - 1];
+    row->max_us = lat[n - 1];
+}
+
+FRESULT bench_sequential(const char *path, uint8_t *buf, size_t size,
+                         uint32_t kib, bench_row_t rows[2]) {
+    static FIL fil;
+    UINT bx;
+    uint32_t total = kib * 1024, done;
+    FRESULT fr = f_open(&fil, path, FA_WRITE | FA_CREATE_ALWAYS);
+    if (FR_OK != fr) return fr;
+    uint64_t t0 = time_us_64();
+    for (done = 0; done < total && FR_OK == fr; done += bx) {
+        fr = f_write(&fil, buf, total - done < size ? total - done : size, &bx);
+        if (FR_OK == fr && !bx) fr = FR_DENIED;  // Volume full
+    }
+    FRESULT fr2 = f_close(&fil);  // The final f_sync counts
+    uint64_t us = time_us_64() - t0;
+    if (FR_OK != fr || FR_OK != fr2) return FR_OK != fr ? fr : fr2;
+    rows[0] = (bench_row_t){.test = "seq_write",
+                            .bytes = size,
+                            .n = (total + size - 1) / size,
+                            .mb_s = us ? (float)total / us : 0};
+
+    fr = f_open(&fil, path, FA_READ);
+    if (FR_OK != fr) return fr;
+    t0 = time_us_64();
+    for (done = 0; done < total; done += bx) {
+        fr = f_read(&fil, buf, size, &bx);
+        if (FR_OK != fr || !bx) break;
+    }
+    us = time_us_64() - t0;
+    f_close(&fil);
+    rows[1] = (bench_row_t){.test = "seq_read",
+                            .bytes = size,
+                            .n = rows[0].n,
+                            .mb_s = us ? (float)done / us : 0};
+    return fr;
+}
+
+FRESULT bench_random(const char *path, uint8_t *buf, bench_row_t rows[2]) {
+    static FIL fil;
+    static uint32_t lat[BENCH_RANDOM_N];
+    uint32_t seed = 2463534242u;  // xorshift32: the same offsets every run
+    FRESULT fr = f_open(&fil, path, FA_READ | FA_WRITE);
+    if (FR_OK != fr) return fr;
+    FSIZE_t sectors = f_size(&fil) / FF_MAX_SS;
+    if (!sectors) fr = FR_INVALID_PARAMETER;
+    for (int w = 0; w < 2 && FR_OK == fr; w++) {
+        uint64_t total_us = 0;
+        for (uint32_t i = 0; i < BENCH_RANDOM_N && FR_OK == fr; i++) {
+            seed ^= seed << 13;
+            seed ^= seed >> 17;
+            seed ^= seed << 5;
+            UINT bx;
+            uint64_t t0 = time_us_64();
+            fr = f_lseek(&fil, (FSIZE_t)(seed % sectors) * FF_MAX_SS);
+            if (FR_OK == fr)
+                fr = w ? f_write(&fil, buf, FF_MAX_SS, &bx)
+                       : f_read(&fil, buf, FF_MAX_SS, &bx);
+            if (FR_OK == fr && FF_MAX_SS != bx) fr = FR_DENIED;
+            lat[i] = time_us_64() - t0;
+            total_us += lat[i];
+        }
+        if (FR_OK != fr) break;
+        rows[w] = (bench_row_t){
+            .test = w ? "rand_write" : "rand_read",
+            .bytes = FF_MAX_SS,
+            .mb_s = total_us ? (float)FF_MAX_SS * BENCH_RANDOM_N / total_us
+                             : 0};
+        bench_percentiles(&rows[w], lat, BENCH_RANDOM_N);
+    }
+    FRESULT fr2 = f_close(&fil);
+    return FR_OK != fr ? fr : fr2;
+}
+
+FRESULT bench_append(const char *path, const uint8_t *buf, size_t size,
+                     bool sync, bench_row_t *row) {
+    static FIL fil;
+    static uint32_t lat[BENCH_APPEND_N];
+    UINT bw;
+    FRESULT fr = f_open(&fil, path, FA_WRITE | FA_CREATE_ALWAYS);
+    if (FR_OK != fr) return fr;
+    uint64_t total_us = 0;
+    for (uint32_t i = 0; i < BENCH_APPEND_N && FR_OK == fr; i++) {
+        uint64_t t0 = time_us_64();
+        fr = f_write(&fil, buf, size, &bw);
+        if (sync && FR_OK == fr) {
+            t0 = time_us_64();
+            fr = f_sync(&fil);
+        }
+        lat[i] = time_us_64() - t0;
+        total_us += lat[i];
+    }
+    FRESULT fr2 = f_close(&fil);
+    if (FR_OK != fr || FR_OK != fr2) return FR_OK != fr ? fr : fr2;
+    *row = (bench_row_t){
+        .test = sync ? "f_sync" : "append",
+        .bytes = size,
+        .mb_s = sync || !total_us ? 0 : (float)size * BENCH_APPEND_N / total_us};
+    bench_percentiles(row, lat, BENCH_APPEND_N);
+    return FR_OK;
+}
+
+FRESULT bench_mount(FATFS *fs, const char *drive, bench_row_t *row) {
+    sd_card_t *pSD = NULL;
+    for (size_t i = 0; i < sd_get_num(); i++)
+        if (0 == strcmp(sd_get_by_num(i)->pcName, drive)) pSD = sd_get_by_num(i);
+    if (!pSD) return FR_INVALID_DRIVE;
+    uint32_t lat[BENCH_MOUNT_N];
+    for (uint32_t i = 0; i < BENCH_MOUNT_N; i++) {
+        f_unmount(drive);
+        pSD->m_Status |= STA_NOINIT;  // Init and clock negotiation again
+        uint64_t t0 = time_us_64();
+        FRESULT fr = f_mount(fs, drive, 1);
+        lat[i] = time_us_64() - t0;
+        if (FR_OK != fr) return fr;
+    }
+    *row = (bench_row_t){.test = "mount"};
+    bench_percentiles(row, lat, BENCH_MOUNT_N);
+    return FR_OK;
+}
+
+size_t bench_run(FATFS *fs, const char *drive, const char *path, uint8_t *buf,
+                 size_t size, uint32_t kib, bench_row_t rows[BENCH_ROWS],
+                 FRESULT *fr) {
+    static const uint32_t append_sizes[] = {64, 512, 4096, 32768};
+    size_t n = 0;
+    *fr = bench_sequential(path, buf, size, kib, &rows[n]);
+    if (FR_OK == *fr) n += 2;
+    if (FR_OK == *fr && FR_OK == (*fr = bench_random(path, buf, &rows[n])))
+        n += 2;
+    for (size_t i = 0; i < count_of(append_sizes) && FR_OK == *fr; i++) {
+        if (append_sizes[i] > size) continue;
+        *fr = bench_append(path, buf, append_sizes[i], false, &rows[n]);
+        if (FR_OK == *fr) n++;
+    }
+    if (FR_OK == *fr && FR_OK == (*fr = bench_append(path, buf, 512, true, &rows[n])))
+        n++;
+    f_unlink(path);
+    if (FR_OK == *fr && FR_OK == (*fr = bench_mount(fs, drive, &rows[n])))
+        n++;
+    return n;
+}
+
+int bench_format_row(char *line, size_t len, const bench_row_t *row,
+                     uint32_t spi_hz, uint64_t sectors) {
+    return snprintf(line, len, "%s,%lu,%lu,%.3f,%lu,%lu,%lu,%lu,%llu\n",
+                    row->test, (unsigned long)row->bytes, (unsigned long)row->n,
+                    row->mb_s, (unsigned long)row->p50_us,
+                    (unsigned long)row->p99_us, (unsigned long)row->max_us,
+                    (unsigned long)spi_hz, (unsigned long long)sectors);
+}
+
+/* [] END OF FILE */
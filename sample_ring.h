@@ -0,0 +1,152 @@
+/* sample_ring.h
+Anel SPSC (um produtor, um consumidor) sem travas para amostras do MPU6050.
+
+O produtor (callback do timer ou núcleo 1) só altera 'head' e os contadores;
+o consumidor (gravador do SD) só altera 'tail'. Os índices correm livres em
+32 bits e a capacidade é potência de dois, então a ocupação é head - tail e
+a posição no vetor é índice & mask.
+
+As APIs de reserva/commit e peek/release devolvem blocos contíguos (nunca
+atravessam o fim do vetor), permitindo preencher ou drenar setores inteiros
+de 512 bytes sem cópias intermediárias.
+*/
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+//
+#include "hardware/sync.h"
+
+#define SAMPLE_RING_ALIGN 32 // Separa head e tail em linhas distintas
+
+// Amostra bruta do MPU6050 com o instante de captura lido do timer (16 bytes)
+typedef struct {
+    uint32_t timestamp_us;       // time_us_32() no instante da leitura
+    int16_t accel[3];
+    int16_t gyro[3];
+} imu_sample_t;
+
+_Static_assert(512 % sizeof(imu_sample_t) == 0, "imu_sample_t deve dividir um setor");
+#define SAMPLES_PER_SECTOR (512 / sizeof(imu_sample_t))
+
+typedef struct {
+    // Lado do produtor
+    volatile uint32_t head __attribute__((aligned(SAMPLE_RING_ALIGN)));
+    volatile uint32_t overflows;      // Amostras descartadas com o anel cheio
+    volatile uint32_t high_watermark; // Maior ocupação observada
+    // Lado do consumidor
+    volatile uint32_t tail __attribute__((aligned(SAMPLE_RING_ALIGN)));
+    // Constantes após sample_ring_init()
+    imu_sample_t *buf __attribute__((aligned(SAMPLE_RING_ALIGN)));
+    uint32_t mask;
+} sample_ring_t;
+
+// capacity deve ser potência de dois; buf deve ter capacity elementos
+static inline bool sample_ring_init(sample_ring_t *r, imu_sample_t *buf, uint32_t capacity)
+{
+    if (!capacity || (capacity & (capacity - 1)))
+        return false;
+    r->buf = buf;
+    r->mask = capacity - 1;
+    r->head = r->tail = 0;
+    r->overflows = r->high_watermark = 0;
+    return true;
+}
+
+// Só pode ser chamada com produtor e consumidor parados
+static inline void sample_ring_reset(sample_ring_t *r)
+{
+    r->head = r->tail = 0;
+    r->overflows = r->high_watermark = 0;
+}
+
+static inline uint32_t sample_ring_capacity(const sample_ring_t *r) { return r->mask + 1; }
+static inline uint32_t sample_ring_count(const sample_ring_t *r) { return r->head - r->tail; }
+static inline uint32_t sample_ring_overflows(const sample_ring_t *r) { return r->overflows; }
+static inline uint32_t sample_ring_high_watermark(const sample_ring_t *r) { return r->high_watermark; }
+static inline uint32_t sample_ring_total(const sample_ring_t *r) { return r->head; } // Publicadas desde o reset
+
+// Recomeça a marca máxima da ocupação atual. Pode ser chamada pelo
+// consumidor com o produtor ativo: no pior caso perde um máximo simultâneo.
+static inline void sample_ring_reset_high_watermark(sample_ring_t *r)
+{
+    r->high_watermark = sample_ring_count(r);
+}
+
+// ---------------------------------------------------------------------------
+// Produtor
+// ---------------------------------------------------------------------------
+
+// Reserva até *n posições contíguas livres; *n recebe quantas foram obtidas
+static inline imu_sample_t *sample_ring_reserve(sample_ring_t *r, uint32_t *n)
+{
+    uint32_t head = r->head;
+    uint32_t tail = r->tail;
+    __mem_fence_acquire(); // Lê tail antes de reutilizar as posições liberadas
+    uint32_t free = sample_ring_capacity(r) - (head - tail);
+    uint32_t to_end = sample_ring_capacity(r) - (head & r->mask);
+    if (*n > free)
+        *n = free;
+    if (*n > to_end)
+        *n = to_end;
+    return &r->buf[head & r->mask];
+}
+
+// Publica n posições preenchidas após sample_ring_reserve()
+static inline void sample_ring_commit(sample_ring_t *r, uint32_t n)
+{
+    uint32_t head = r->head + n;
+    __mem_fence_release(); // Os dados ficam visíveis antes do novo head
+    r->head = head;
+    uint32_t level = head - r->tail;
+    if (level > r->high_watermark)
+        r->high_watermark = level;
+}
+
+// Contabiliza amostras que o produtor não conseguiu armazenar
+static inline void sample_ring_overflow(sample_ring_t *r, uint32_t n)
+{
+    r->overflows += n;
+}
+
+static inline bool sample_ring_push(sample_ring_t *r, const imu_sample_t *s)
+{
+    uint32_t n = 1;
+    imu_sample_t *slot = sample_ring_reserve(r, &n);
+    if (!n)
+    {
+        sample_ring_overflow(r, 1);
+        return false;
+    }
+    *slot = *s;
+    sample_ring_commit(r, 1);
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// Consumidor
+// ---------------------------------------------------------------------------
+
+// Até *n amostras contíguas prontas para leitura; *n recebe quantas há
+static inline const imu_sample_t *sample_ring_peek(sample_ring_t *r, uint32_t *n)
+{
+    uint32_t tail = r->tail;
+    uint32_t head = r->head;
+    __mem_fence_acquire(); // Lê head antes dos dados que ele publica
+    uint32_t avail = head - tail;
+    uint32_t to_end = sample_ring_capacity(r) - (tail & r->mask);
+    if (*n > avail)
+        *n = avail;
+    if (*n > to_end)
+        *n = to_end;
+    return &r->buf[tail & r->mask];
+}
+
+// Libera n amostras lidas após sample_ring_peek()
+static inline void sample_ring_release(sample_ring_t *r, uint32_t n)
+{
+    __mem_fence_release(); // Termina as leituras antes de devolver as posições
+    r->tail = r->tail + n;
+}
+
+/* [] END OF FILE */
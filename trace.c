@@ -0,0 +1,118 @@
+/* trace.c
+Anéis de eventos por núcleo e exportação para o Chrome Trace. Ver trace.h.
+*/
+#include "trace.h"
+
+#if USE_TRACE
+
+#include <stdio.h>
+//
+#include "pico/stdlib.h"
+#include "hardware/sync.h"
+
+_Static_assert((TRACE_RING_LEN & (TRACE_RING_LEN - 1)) == 0, "TRACE_RING_LEN deve ser potência de dois");
+
+typedef struct {
+    uint32_t t_us;
+    uint8_t id;
+    uint8_t begin;
+} trace_event_t;
+
+static const struct {
+    const char *name;
+    bool async; // Início e fim em contextos diferentes
+} events[TRACE_EV_COUNT] = {
+    [TRACE_EV_I2C_READ] = {"i2c_read", true},
+    [TRACE_EV_CONVERT] = {"convert", false},
+    [TRACE_EV_UI_FORMAT] = {"snprintf", false},
+    [TRACE_EV_DISPLAY] = {"display", false},
+    [TRACE_EV_F_WRITE] = {"f_write", false},
+    [TRACE_EV_DISK_WRITE] = {"disk_write", false},
+    [TRACE_EV_DISK_READ] = {"disk_read", false},
+    [TRACE_EV_DISK_ASYNC] = {"disk_async", true},
+    [TRACE_EV_SPI_DMA_WAIT] = {"spi_dma_wait", false},
+    [TRACE_EV_SD_WAIT_READY] = {"sd_wait_ready", false},
+};
+
+static trace_event_t rings[2][TRACE_RING_LEN];
+static uint32_t heads[2]; // Eventos já gravados; índice livre em 32 bits
+static volatile bool enabled = true;
+
+void __not_in_flash_func(trace_record)(trace_event_id_t id, bool begin)
+{
+    if (!enabled)
+        return;
+    uint core = get_core_num();
+    uint32_t save = save_and_disable_interrupts();
+    trace_event_t *e = &rings[core][heads[core]++ & (TRACE_RING_LEN - 1)];
+    e->t_us = time_us_32();
+    e->id = id;
+    e->begin = begin;
+    restore_interrupts(save);
+}
+
+void trace_enable(bool on) { enabled = on; }
+bool trace_is_enabled(void) { return enabled; }
+
+uint32_t trace_count(unsigned core)
+{
+    return heads[core] < TRACE_RING_LEN ? heads[core] : TRACE_RING_LEN;
+}
+
+void trace_clear(void)
+{
+    bool was = enabled;
+    enabled = false;
+    heads[0] = heads[1] = 0;
+    enabled = was;
+}
+
+static const trace_event_t *oldest(unsigned core)
+{
+    return &rings[core][heads[core] > TRACE_RING_LEN ? heads[core] & (TRACE_RING_LEN - 1) : 0];
+}
+
+// Os instantes saem relativos ao evento mais antigo dos dois anéis, o que
+// também resolve a volta do contador de 32 bits
+void trace_dump(void)
+{
+    bool was = enabled;
+    enabled = false; // Os anéis ficam parados durante a exportação
+    sleep_us(100);   // Deixa terminar um trace_record em andamento no outro núcleo
+
+    uint32_t t0 = time_us_32();
+    for (unsigned core = 0; core < 2; core++)
+        if (trace_count(core) && (int32_t)(oldest(core)->t_us - t0) < 0)
+            t0 = oldest(core)->t_us;
+
+    printf("{\"traceEvents\":[\n");
+    for (unsigned core = 0; core < 2; core++)
+        printf("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":%u,\"args\":{\"name\":\"core%u\"}},\n",
+               core, core);
+    const char *sep = "";
+    for (unsigned core = 0; core < 2; core++)
+    {
+        uint32_t n = trace_count(core);
+        uint32_t first = heads[core] - n;
+        for (uint32_t i = 0; i < n; i++)
+        {
+            const trace_event_t *e = &rings[core][(first + i) & (TRACE_RING_LEN - 1)];
+            if (e->id >= TRACE_EV_COUNT)
+                continue;
+            if (events[e->id].async)
+                printf("%s{\"name\":\"%s\",\"cat\":\"async\",\"ph\":\"%c\",\"id\":%u,\"ts\":%lu,\"pid\":0,\"tid\":%u}",
+                       sep, events[e->id].name, e->begin ? 'b' : 'e', e->id, (unsigned long)(e->t_us - t0), core);
+            else
+                printf("%s{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%lu,\"pid\":0,\"tid\":%u}", sep,
+                       events[e->id].name, e->begin ? 'B' : 'E', (unsigned long)(e->t_us - t0), core);
+            sep = ",\n";
+        }
+    }
+    printf("\n]}\n");
+    stdio_flush();
+    enabled = was;
+}
+
+#endif
+
+/* [] END OF FILE */
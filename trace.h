@@ -0,0 +1,70 @@
+/* trace.h
+Rastreamento de tempo dos caminhos quentes da gravação.
+
+TRACE_BEGIN(id) e TRACE_END(id) gravam um evento (instante do timer de 1 us,
+id, início/fim) num anel em RAM do núcleo que os chamou; cada núcleo tem o
+seu, então não há disputa entre eles, e a interrupção fica desligada só
+durante a escrita do evento. Quando o anel enche, os eventos mais antigos são
+sobrescritos. O comando 'trace dump' envia os dois anéis como JSON do
+Chrome Trace (chrome://tracing ou ui.perfetto.dev), um "thread" por núcleo.
+
+Com USE_TRACE = 0 (o padrão) as macros não geram código e trace.c fica vazio.
+Os eventos marcados como assíncronos em trace.c começam num contexto e
+terminam noutro (interrupção, volta seguinte do laço) e saem como eventos
+assíncronos, que não precisam estar aninhados.
+*/
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifndef USE_TRACE
+#define USE_TRACE 0
+#endif
+
+#ifndef TRACE_RING_LEN
+#define TRACE_RING_LEN 1024 // Eventos por núcleo (potência de dois): 8 KiB cada
+#endif
+
+typedef enum {
+    TRACE_EV_I2C_READ,      // Transferência I2C por DMA (assíncrono)
+    TRACE_EV_CONVERT,       // Amostras do anel para registros binários
+    TRACE_EV_UI_FORMAT,     // snprintf das mensagens do display
+    TRACE_EV_DISPLAY,       // ssd1306_send_data
+    TRACE_EV_F_WRITE,       // f_write do gravador
+    TRACE_EV_DISK_WRITE,    // disk_write síncrono
+    TRACE_EV_DISK_READ,     // disk_read síncrono
+    TRACE_EV_DISK_ASYNC,    // Pedido da fila de disk_async.h, do início à conclusão (assíncrono)
+    TRACE_EV_SPI_DMA_WAIT,  // spi_transfer_wait_complete
+    TRACE_EV_SD_WAIT_READY, // sd_wait_ready: cartão ocupado
+    TRACE_EV_COUNT
+} trace_event_id_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if USE_TRACE
+
+void trace_record(trace_event_id_t id, bool begin);
+void trace_enable(bool enabled);
+bool trace_is_enabled(void);
+uint32_t trace_count(unsigned core); // Eventos no anel do núcleo
+void trace_clear(void);
+void trace_dump(void);               // JSON do Chrome Trace em stdout
+
+#define TRACE_BEGIN(id) trace_record((id), true)
+#define TRACE_END(id) trace_record((id), false)
+
+#else
+
+#define TRACE_BEGIN(id) ((void)0)
+#define TRACE_END(id) ((void)0)
+
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+/* [] END OF FILE */